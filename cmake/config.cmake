@@ -29,6 +29,7 @@ if(NOT ZOOM_CONFIG_DEFINED)
 	endif()
 
 	find_package(OpenGL REQUIRED)
+	find_package(Threads REQUIRED)
 	find_package(SFML REQUIRED graphics window system)
         find_package(Zoost REQUIRED)
 
@@ -65,6 +65,19 @@
 
 #endif
 
+////////////////////////////////////////////////////////////
+// Define the SIMD instruction set of the kernels, AVX or SSE
+// as the compiler targets them. Define ZOOM_NO_SIMD to build
+// the scalar kernels only.
+////////////////////////////////////////////////////////////
+#if !defined(ZOOM_NO_SIMD) && defined(__AVX__)
+    #include <immintrin.h>
+    #define ZOOM_AVX
+#elif !defined(ZOOM_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+    #include <xmmintrin.h>
+    #define ZOOM_SSE
+#endif
+
 ////////////////////////////////////////////////////////////
 // Define portable fixed-size types
 ////////////////////////////////////////////////////////////
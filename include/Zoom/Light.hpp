@@ -28,12 +28,14 @@
 ////////////////////////////////////////////////////////////
 // Headers
 ////////////////////////////////////////////////////////////
+#include <atomic>
 #include <Zoost/Geom.hpp>
 #include <Zoost/Segment.hpp>
 #include <Zoost/Line.hpp>
 #include <Zoost/Vector2.hpp>
 #include <Zoom/Shape.hpp>
 #include <Zoom/Color.hpp>
+#include <Zoom/Visibility.hpp>
 #include <Zoom/Config.hpp>
 
 namespace zin
@@ -42,17 +44,56 @@ namespace zin
 class ZOOM_API Light : public Geom, public sf::Drawable
 {
 public:
+
+    ////////////////////////////////////////////////////////////
+    // Algorithm used to compute the lit polygon
+    ////////////////////////////////////////////////////////////
+    enum Algorithm
+    {
+        Recursive, // Clip every wedge against every segment
+        Sweep      // Sweep the endpoints sorted by angle
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Attenuation curve from the center to the radius
+    ////////////////////////////////////////////////////////////
+    enum Falloff
+    {
+        Linear,
+        Quadratic,
+        Smoothstep
+    };
     
     ////////////////////////////////////////////////////////////
-    // Default constructor
+    // Default constructor. The light is attenuated per pixel if
+    // the falloff shader is available at this point (see
+    // ShaderLibrary), otherwise by its vertices
     ////////////////////////////////////////////////////////////
 	Light(double radius = 100, Color color = Color{255, 255, 255, 200}, Uint32 complexity = 16);
     
     ////////////////////////////////////////////////////////////
-    // Generate the light
+    // Generate the light and show it right away
     ////////////////////////////////////////////////////////////
 	virtual void generate(const std::vector<Segment>& segments);
 
+    ////////////////////////////////////////////////////////////
+    // Generate the light into its back buffer, as seen with a
+    // snapshot of its transform, while the front buffer may be
+    // drawn. Distinct lights may be generated concurrently.
+    ////////////////////////////////////////////////////////////
+    void generate(const std::vector<Segment>& segments, const double* transform);
+
+    ////////////////////////////////////////////////////////////
+    // Show the light generated in the back buffer
+    ////////////////////////////////////////////////////////////
+    void swapBuffers();
+
+    ////////////////////////////////////////////////////////////
+    // Show the polygon with another transform without generating
+    // it again, for a light which ignores the occluders
+    ////////////////////////////////////////////////////////////
+    void setRenderTransform(const double* transform);
+
     ////////////////////////////////////////////////////////////
     // Set the debug mode
     ////////////////////////////////////////////////////////////
@@ -63,34 +104,175 @@ public:
     ////////////////////////////////////////////////////////////
     bool getDebugMode();
 
+    ////////////////////////////////////////////////////////////
+    // Set the algorithm used to compute the lit polygon
+    ////////////////////////////////////////////////////////////
+    void setAlgorithm(Algorithm algorithm);
+
+    ////////////////////////////////////////////////////////////
+    // Get the algorithm used to compute the lit polygon
+    ////////////////////////////////////////////////////////////
+    Algorithm getAlgorithm() const;
+
+    ////////////////////////////////////////////////////////////
+    // Set the attenuation curve, only the linear one is
+    // available without shaders
+    ////////////////////////////////////////////////////////////
+    void setFalloff(Falloff falloff);
+
+    ////////////////////////////////////////////////////////////
+    // Get the attenuation curve
+    ////////////////////////////////////////////////////////////
+    Falloff getFalloff() const;
+
+    ////////////////////////////////////////////////////////////
+    // Set the number of wedges of the light
+    ////////////////////////////////////////////////////////////
+    void setComplexity(Uint32 complexity);
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of wedges of the light
+    ////////////////////////////////////////////////////////////
+    Uint32 getComplexity() const;
+
+    ////////////////////////////////////////////////////////////
+    // Let the number of wedges follow the size of the light on
+    // screen, within the given bounds
+    ////////////////////////////////////////////////////////////
+    void enableAdaptiveComplexity(bool enabled = true, Uint32 minComplexity = 4, Uint32 maxComplexity = 128);
+
+    ////////////////////////////////////////////////////////////
+    // Adapt the number of wedges to a scale in pixels per unit
+    ////////////////////////////////////////////////////////////
+    void adaptComplexity(double scale);
+
+    ////////////////////////////////////////////////////////////
+    // Set the radius of the light
+    ////////////////////////////////////////////////////////////
+    void setRadius(double radius);
+
+    ////////////////////////////////////////////////////////////
+    // Get the radius of the light
+    ////////////////////////////////////////////////////////////
+    double getRadius() const;
+
+    ////////////////////////////////////////////////////////////
+    // Set the color of the light
+    ////////////////////////////////////////////////////////////
+    void setColor(const Color& color);
+
+    ////////////////////////////////////////////////////////////
+    // Get the color of the light
+    ////////////////////////////////////////////////////////////
+    const Color& getColor() const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the angle lit from the x axis of the light
+    ////////////////////////////////////////////////////////////
+    virtual double getAperture() const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the center of the light in global coordinates
+    ////////////////////////////////////////////////////////////
+    Point getGlobalCenter() const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the radius of the light in global coordinates
+    ////////////////////////////////////////////////////////////
+    double getGlobalRadius() const;
+
+    ////////////////////////////////////////////////////////////
+    // Return true if a global segment is in the reach of the light
+    ////////////////////////////////////////////////////////////
+    bool reaches(const Segment& segment) const;
+
+    ////////////////////////////////////////////////////////////
+    // Return true if the light must be generated again
+    ////////////////////////////////////////////////////////////
+    bool isOutdated() const;
+
+    ////////////////////////////////////////////////////////////
+    // Append the triangles of the light, in global coordinates,
+    // to a batch drawn in a single call
+    ////////////////////////////////////////////////////////////
+    void appendTo(sf::VertexArray& batch) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the lit triangles in local coordinates, as pairs of
+    // points forming a fan around the center of the light
+    ////////////////////////////////////////////////////////////
+    const std::vector<sf::Vector2f>& getFan() const;
+
+    ////////////////////////////////////////////////////////////
+    // Copy the lit triangles into a geom, in global coordinates
+    ////////////////////////////////////////////////////////////
+    void exportTo(Geom& geom) const;
+
 protected:
 
     ////////////////////////////////////////////////////////////
-    // Add a triangle to the shape and compute intersections
+    // Return true if a local segment is in the reach of the light
+    ////////////////////////////////////////////////////////////
+    virtual bool isInReach(const Segment& segment) const;
+
+    ////////////////////////////////////////////////////////////
+    // Add a triangle to the light and compute its intersections
+    // with local segments, skipping the ones the buffer culls
     ////////////////////////////////////////////////////////////
 	void addTriangle(Point p1, Point p2, Uint32 begin, const std::vector<Segment>& segments);
 
+    ////////////////////////////////////////////////////////////
+    // Add a lit triangle to the fan
+    ////////////////////////////////////////////////////////////
+    void pushTriangle(const Point& p1, const Point& p2);
+
     ////////////////////////////////////////////////////////////
     // Draw the light
     ////////////////////////////////////////////////////////////
     void draw(sf::RenderTarget& target, sf::RenderStates states) const;
 
     ////////////////////////////////////////////////////////////
-    // Update the rendering
+    // Update the rendering, only called by the drawing thread
     ////////////////////////////////////////////////////////////
     void update() const;
 
+    ////////////////////////////////////////////////////////////
+    // Get the color of the light at a local point
+    ////////////////////////////////////////////////////////////
+    sf::Color getShade(const sf::Vector2f& point) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the transform the shown polygon was generated with
+    ////////////////////////////////////////////////////////////
+    sf::Transform getRenderTransform() const;
+
     ////////////////////////////////////////////////////////////
     // Member data
     ////////////////////////////////////////////////////////////
     bool                                 m_debugMode = false;
-    mutable bool                         m_needUpdate = false;
+    mutable std::atomic<bool>            m_needUpdate;
+    std::atomic<bool>                    m_isOutdated;
 	double                               m_radius;
 	Color                                m_color;
 	Uint32                               m_complexity;
-    std::vector<Color>                   m_colors;
-    mutable std::vector<sf::VertexArray> m_vertexArray;
-    mutable std::vector<sf::VertexArray> m_vertexArrayDebug;
+    bool                                 m_isComplexityAdaptive;
+    Uint32                               m_minComplexity;
+    Uint32                               m_maxComplexity;
+    Algorithm                            m_algorithm;
+    Falloff                              m_falloff;
+    bool                                 m_isShaded;
+    Visibility                           m_visibility;
+    std::vector<Segment>                 m_localSegments;
+    SegmentBuffer                        m_localBuffer;
+    std::vector<Uint8>                   m_culled;
+    std::vector<Point>                   m_polygon;
+    std::vector<sf::Vector2f>            m_fan;
+    std::vector<sf::Vector2f>            m_nextFan;
+    double                               m_fanTransform[9];
+    double                               m_nextFanTransform[9];
+    mutable sf::VertexArray              m_vertexArray;
+    mutable sf::VertexArray              m_vertexArrayWireframe;
+    mutable sf::VertexArray              m_vertexArrayDebug;
 };
 
 }
@@ -28,9 +28,18 @@
 // Headers
 ////////////////////////////////////////////////////////////
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_map>
 #include <SFML/Graphics.hpp>
 #include <Zoom/Light.hpp>
 #include <Zoom/Spot.hpp>
+#include <Zoom/SegmentGrid.hpp>
+#include <Zoom/SlotMap.hpp>
 #include <Zoom/Config.hpp>
 
 namespace zin
@@ -40,38 +49,178 @@ class ZOOM_API LightManager : public sf::Drawable
 {
 public:
 
+    ////////////////////////////////////////////////////////////
+    // Way the shadows are computed
+    ////////////////////////////////////////////////////////////
+    enum Mode
+    {
+        Geometry,      // Clip the lights on the CPU
+        ShadowVolume,  // Mask the lights with occluders extruded on the GPU
+        PolarShadowMap // Compare each pixel with a polar depth row per light
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Handles to the attached lights and geoms
+    ////////////////////////////////////////////////////////////
+    typedef Handle<Light> LightHandle;
+    typedef Handle<Geom>  GeomHandle;
+
     ////////////////////////////////////////////////////////////
     // Default constructor
     ////////////////////////////////////////////////////////////
     LightManager(Uint32 width = 800, Uint32 height = 600, const Color& ambiantLightColor = Color(50, 50, 50, 128));
+
+    ////////////////////////////////////////////////////////////
+    // Destructor
+    ////////////////////////////////////////////////////////////
+    ~LightManager();
     
     ////////////////////////////////////////////////////////////
-    // Attach a light to the manager
+    // Attach a light to the manager, a static light is drawn
+    // once into a cached lightmap, with the static geoms only
     ////////////////////////////////////////////////////////////
-	void attach(Light& light);
+	LightHandle attach(Light& light, bool isStatic = false);
     
     ////////////////////////////////////////////////////////////
-    // Detach a light from the manager
+    // Detach a light from the manager, without waiting for its
+    // generation. In asynchronous mode the light may still be
+    // generated until the next update, it must live until then
     ////////////////////////////////////////////////////////////
     void detach(Light& light);
+
+    ////////////////////////////////////////////////////////////
+    // Detach a light from the manager by its handle, see above
+    ////////////////////////////////////////////////////////////
+    void detach(LightHandle handle);
     
     ////////////////////////////////////////////////////////////
-    // Attach a geom to the manager
+    // Attach a geom to the manager, a static geom also casts
+    // the shadows of the static lights
     ////////////////////////////////////////////////////////////
-    void attach(const Geom& geom);
+    GeomHandle attach(const Geom& geom, bool isStatic = false);
     
     ////////////////////////////////////////////////////////////
     // Detach a geom from the manager
     ////////////////////////////////////////////////////////////
     void detach(const Geom& geom);
 
+    ////////////////////////////////////////////////////////////
+    // Detach a geom from the manager by its handle
+    ////////////////////////////////////////////////////////////
+    void detach(GeomHandle handle);
+
     ////////////////////////////////////////////////////////////
     // Set the blend mode
     ////////////////////////////////////////////////////////////
     void setBlendMode(sf::BlendMode blendMode);
+
+    ////////////////////////////////////////////////////////////
+    // Set the size of the cells of the occluders grid, a size
+    // which is not positive is ignored
+    ////////////////////////////////////////////////////////////
+    void setGridCellSize(double cellSize);
+
+    ////////////////////////////////////////////////////////////
+    // Simplify the outlines of the geoms, dropping the details
+    // under the tolerance. The collinear segments are always
+    // merged, 0 does nothing more
+    ////////////////////////////////////////////////////////////
+    void setSimplification(double tolerance);
+
+    ////////////////////////////////////////////////////////////
+    // Set the number of threads generating the lights,
+    // 0 uses the number of cores, 1 disables the threading
+    ////////////////////////////////////////////////////////////
+    void setThreadsCount(Uint32 count);
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of threads generating the lights
+    ////////////////////////////////////////////////////////////
+    Uint32 getThreadsCount() const;
+
+    ////////////////////////////////////////////////////////////
+    // Set the time the lights may take to be generated in every
+    // update, the others keep their polygon until a later one,
+    // 0 generates all of them
+    ////////////////////////////////////////////////////////////
+    void setUpdateBudget(Uint32 microseconds);
+
+    ////////////////////////////////////////////////////////////
+    // Get the time the lights may take to be generated in every
+    // update
+    ////////////////////////////////////////////////////////////
+    Uint32 getUpdateBudget() const;
+
+    ////////////////////////////////////////////////////////////
+    // Generate the lights on a background job running from an
+    // update to the next one, meanwhile the lights are drawn with
+    // their previous polygon. Until the next update, only the
+    // transforms of the lights and the geoms may be changed
+    ////////////////////////////////////////////////////////////
+    void enableAsyncGeneration(bool enabled = true);
+
+    ////////////////////////////////////////////////////////////
+    // Merge the lights smaller on screen than the threshold, in
+    // pixels, into a single light per cluster, and split them
+    // back once they grow, 0 disables it. The static lights are
+    // never merged
+    ////////////////////////////////////////////////////////////
+    void setClusterThreshold(double threshold);
+
+    ////////////////////////////////////////////////////////////
+    // Get the size on screen under which the lights are merged
+    ////////////////////////////////////////////////////////////
+    double getClusterThreshold() const;
+
+    ////////////////////////////////////////////////////////////
+    // Merge the lights into a single draw call
+    ////////////////////////////////////////////////////////////
+    void enableBatching(bool enabled = true);
+
+    ////////////////////////////////////////////////////////////
+    // Set the way the shadows are computed, the GPU modes are
+    // ignored if the shaders are not available
+    ////////////////////////////////////////////////////////////
+    void setMode(Mode mode);
+
+    ////////////////////////////////////////////////////////////
+    // Get the way the shadows are computed
+    ////////////////////////////////////////////////////////////
+    Mode getMode() const;
+
+    ////////////////////////////////////////////////////////////
+    // Set the number of angles of the polar shadow maps
+    ////////////////////////////////////////////////////////////
+    void setShadowMapResolution(Uint32 resolution);
     
     ////////////////////////////////////////////////////////////
-    // Update the lights
+    // Set the view the lights are seen from, the lights out of
+    // it are neither generated nor drawn. The static lights are
+    // baked with a margin around it, and baked again only once
+    // the view leaves that margin or changes its size or angle
+    ////////////////////////////////////////////////////////////
+    void setView(const sf::View& view);
+
+    ////////////////////////////////////////////////////////////
+    // Forget the view, every light is generated and drawn
+    ////////////////////////////////////////////////////////////
+    void resetView();
+
+    ////////////////////////////////////////////////////////////
+    // Set the resolution of the lightmap relative to the size of
+    // the manager, a reduced lightmap is stretched and smoothed
+    // when drawn
+    ////////////////////////////////////////////////////////////
+    void setResolutionScale(double scale);
+
+    ////////////////////////////////////////////////////////////
+    // Get the resolution of the lightmap relative to the size of
+    // the manager
+    ////////////////////////////////////////////////////////////
+    double getResolutionScale() const;
+
+    ////////////////////////////////////////////////////////////
+    // Update the lights which moved or whose occluders changed
     ////////////////////////////////////////////////////////////
     void update();
 
@@ -86,22 +235,304 @@ public:
     bool getDebugMode();
     
 private:
+
+    typedef std::chrono::steady_clock Clock;
+
+    ////////////////////////////////////////////////////////////
+    // LightInfo structure
+    ////////////////////////////////////////////////////////////
+    struct LightInfo
+    {
+        LightHandle handle;
+        Light*      light;
+        double      transform[9];
+        bool        dirty;
+        bool        isStatic;
+        bool        isAggregate;
+        bool        isClustered;
+        bool        isMerged;
+        bool        hasDisc;
+        Uint32      staleness;
+        double      priority;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Task structure, a light to generate with the transform it
+    // had when the task was created
+    ////////////////////////////////////////////////////////////
+    struct Task
+    {
+        LightHandle handle;
+        Light*      light;
+        double      transform[9];
+        bool        isStatic;
+        bool        done;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Cluster structure, a light owned by the manager standing
+    // for the small lights of a cell
+    ////////////////////////////////////////////////////////////
+    struct Cluster
+    {
+        std::unique_ptr<Light>  light;
+        LightHandle             handle;
+        std::vector<LightInfo*> members;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Worker structure, holding the buffers of a thread
+    ////////////////////////////////////////////////////////////
+    struct Worker
+    {
+        std::vector<Uint32>  indices;
+        std::vector<Segment> segments;
+        std::vector<char>    sides;
+        std::vector<Int32>   loops;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Occluder structure, watching an attached geom
+    ////////////////////////////////////////////////////////////
+    struct Occluder : public Geom::Observer
+    {
+        ////////////////////////////////////////////////////////////
+        // Default constructor
+        ////////////////////////////////////////////////////////////
+        Occluder(const Geom& geom, bool isStatic);
+
+        ////////////////////////////////////////////////////////////
+        // Load the segments of the geom, the closed loops first,
+        // each one starting at an indice of loops
+        ////////////////////////////////////////////////////////////
+        void load(double tolerance);
+
+        ////////////////////////////////////////////////////////////
+        // Trace the chains of liaisons of the geom into the outline
+        ////////////////////////////////////////////////////////////
+        void trace(double tolerance);
+
+        ////////////////////////////////////////////////////////////
+        // Methods called when the geom changes
+        ////////////////////////////////////////////////////////////
+        void onTransformUpdated();
+        void onVertexAdded();
+        void onLiaisonAdded();
+        void onFaceAdded();
+        void onVertexRemoved(size_t indice);
+        void onLiaisonRemoved(size_t indice);
+        void onFaceRemoved(size_t indice);
+        void onVertexMoved();
+        void onErasing();
+
+        ////////////////////////////////////////////////////////////
+        // Member data
+        ////////////////////////////////////////////////////////////
+        const Geom&          geom;
+        bool                 isStatic;
+        bool                 changed;
+        bool                 moved;
+        std::vector<Point>   outline;
+        std::vector<Uint32>  chains;
+        size_t               closedCount;
+        std::vector<Segment> segments;
+        std::vector<Uint32>  loops;
+        Point                min,
+                             max;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Occlusion structure, the segments of a set of occluders
+    // and the closed loops they form
+    ////////////////////////////////////////////////////////////
+    struct Occlusion
+    {
+        ////////////////////////////////////////////////////////////
+        // Add the segments of an occluder
+        ////////////////////////////////////////////////////////////
+        void insert(const Occluder& occluder);
+
+        ////////////////////////////////////////////////////////////
+        // Remove the segments of an occluder, their indices stay
+        // taken until the next clear
+        ////////////////////////////////////////////////////////////
+        void remove(const Occluder& occluder);
+
+        ////////////////////////////////////////////////////////////
+        // Remove all the segments
+        ////////////////////////////////////////////////////////////
+        void clear();
+
+        ////////////////////////////////////////////////////////////
+        // Return true if a point is inside a closed loop
+        ////////////////////////////////////////////////////////////
+        bool contains(Int32 loop, const Point& point) const;
+
+        ////////////////////////////////////////////////////////////
+        // Member data
+        ////////////////////////////////////////////////////////////
+        SegmentGrid                                                     grid;
+        std::vector<Int32>                                              loops;
+        std::vector<Uint32>                                             ranges;
+        std::unordered_map<const Occluder*, std::pair<Uint32, Uint32>>  blocks;
+    };
     
     ////////////////////////////////////////////////////////////
     // Draw the lights
     ////////////////////////////////////////////////////////////
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
 
+    ////////////////////////////////////////////////////////////
+    // Create a texture at the resolution of the lightmap, times
+    // a scale, if its size differs
+    ////////////////////////////////////////////////////////////
+    void create(sf::RenderTexture& texture, double scale = 1);
+
+    ////////////////////////////////////////////////////////////
+    // Check whether the view still falls within the area the
+    // static lights were baked over
+    ////////////////////////////////////////////////////////////
+    bool isInBakedArea() const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the box around a view
+    ////////////////////////////////////////////////////////////
+    void getVisibleArea(const sf::View& view, Point& min, Point& max) const;
+
+    ////////////////////////////////////////////////////////////
+    // Draw lights shadowed by the occluders of a grid
+    ////////////////////////////////////////////////////////////
+    void drawLights(sf::RenderTexture& target, const std::vector<Light*>& lights, const SegmentGrid& grid, const Point& min, const Point& max);
+
+    ////////////////////////////////////////////////////////////
+    // Build the occluder lines of the polar shadow maps within a
+    // box
+    ////////////////////////////////////////////////////////////
+    void buildOccluders(const SegmentGrid& grid, const Point& min, const Point& max);
+
+    ////////////////////////////////////////////////////////////
+    // Mark the lights reaching the bounds of an occluder
+    ////////////////////////////////////////////////////////////
+    void invalidate(const Occluder& occluder);
+
+    ////////////////////////////////////////////////////////////
+    // Gather the small lights into clusters, at the given number
+    // of pixels per unit
+    ////////////////////////////////////////////////////////////
+    void cluster(double scale);
+
+    ////////////////////////////////////////////////////////////
+    // Remove the clusters and show their lights again
+    ////////////////////////////////////////////////////////////
+    void clearClusters();
+
+    ////////////////////////////////////////////////////////////
+    // Generate the light of a task with the segments it reaches
+    ////////////////////////////////////////////////////////////
+    void generate(const Task& task, const Occlusion& occlusion, Worker& worker) const;
+
+    ////////////////////////////////////////////////////////////
+    // Hand the tasks to the threads, and take a share of them
+    // unless the generation is asynchronous
+    ////////////////////////////////////////////////////////////
+    void generatePending();
+
+    ////////////////////////////////////////////////////////////
+    // Generate tasks until none is left or the deadline is
+    // passed with a budget
+    ////////////////////////////////////////////////////////////
+    void work(Worker& worker);
+
+    ////////////////////////////////////////////////////////////
+    // Start the threads, one per worker but the first one which
+    // belongs to the calling thread unless asynchronous
+    ////////////////////////////////////////////////////////////
+    void startThreads();
+
+    ////////////////////////////////////////////////////////////
+    // Stop and join the threads
+    ////////////////////////////////////////////////////////////
+    void stopThreads();
+
+    ////////////////////////////////////////////////////////////
+    // Loop of a thread, working at every round until stopped
+    ////////////////////////////////////////////////////////////
+    void run(Worker& worker, Uint32 round);
+
+    ////////////////////////////////////////////////////////////
+    // Draw the lights masked by the shadow volumes of the
+    // occluders of a grid they reach
+    ////////////////////////////////////////////////////////////
+    void drawShadowVolumes(sf::RenderTarget& target, const std::vector<Light*>& lights, const SegmentGrid& grid);
+
+    ////////////////////////////////////////////////////////////
+    // Wait for the threads and present the generated lights
+    ////////////////////////////////////////////////////////////
+    void finish();
+
+    ////////////////////////////////////////////////////////////
+    // Draw the lights compared with their polar shadow maps
+    ////////////////////////////////////////////////////////////
+    void drawPolarShadowMaps(sf::RenderTarget& target, const std::vector<Light*>& lights);
+
+    ////////////////////////////////////////////////////////////
+    // Draw a chunk of lights fitting in the polar shadow map, the
+    // area is the world rectangle covered by the occlusion texture
+    ////////////////////////////////////////////////////////////
+    void drawPolarShadowMaps(sf::RenderTarget& target, Light* const* lights, size_t count, const sf::FloatRect& area, float width, float height);
     
     ////////////////////////////////////////////////////////////
     // Member data
     ////////////////////////////////////////////////////////////
-    bool                     m_debugMode = false;
-    sf::BlendMode            m_blendMode;
-    sf::RenderTexture        m_renderTexture;
-    sf::Color                m_ambiantLightColor;
-    std::vector<Light*>      m_lights;
-    std::vector<const Geom*> m_geoms;
+    bool                                          m_debugMode = false;
+    bool                                          m_needRebuild = false;
+    bool                                          m_needRedraw = true;
+    bool                                          m_needBake = false;
+    bool                                          m_hasView = false;
+    bool                                          m_isBatchingEnabled = true;
+    bool                                          m_isAsync = false;
+    Mode                                          m_mode;
+    Uint32                                        m_shadowMapResolution;
+    double                                        m_tolerance;
+    Uint32                                        m_width;
+    Uint32                                        m_height;
+    double                                        m_resolutionScale;
+    Uint32                                        m_updateBudget;
+    double                                        m_clusterThreshold;
+    double                                        m_clusterLevel;
+    sf::BlendMode                                 m_blendMode;
+    sf::RenderTexture                             m_renderTexture;
+    sf::RenderTexture                             m_lightTexture;
+    sf::RenderTexture                             m_occlusionTexture;
+    sf::RenderTexture                             m_polarMap;
+    sf::RenderTexture                             m_bakedTexture;
+    sf::Color                                     m_ambiantLightColor;
+    sf::View                                      m_view;
+    sf::View                                      m_bakedView;
+    SlotMap<Light, LightInfo>                     m_lights;
+    SlotMap<Geom, std::unique_ptr<Occluder>>      m_occluders;
+    std::unordered_map<const Light*, LightHandle> m_lightHandles;
+    std::unordered_map<const Geom*, GeomHandle>   m_geomHandles;
+    std::unordered_map<Uint64, Cluster>           m_clusters;
+    Occlusion                                     m_occlusion;
+    Occlusion                                     m_staticOcclusion;
+    std::vector<LightInfo*>                       m_pending;
+    std::vector<Task>                             m_tasks;
+    std::vector<std::thread>                      m_threads;
+    std::mutex                                    m_mutex;
+    std::condition_variable                       m_wakeUp;
+    std::condition_variable                       m_done;
+    Uint32                                        m_round = 0;
+    size_t                                        m_busy = 0;
+    bool                                          m_isStopping = false;
+    std::atomic<size_t>                           m_next;
+    Clock::time_point                             m_deadline;
+    std::vector<Light*>                           m_visible;
+    std::vector<Light*>                           m_staticVisible;
+    std::vector<Worker>                           m_workers;
+    sf::VertexArray                               m_batch;
+    sf::VertexArray                               m_shadows;
+    sf::VertexArray                               m_occluderLines;
 };
 
 }
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#ifndef ZOOM_SEGMENT_BUFFER_HPP
+#define ZOOM_SEGMENT_BUFFER_HPP
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <vector>
+#include <Zoost/Segment.hpp>
+#include <Zoom/Config.hpp>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+// Segments stored as separate arrays of floats, so that a ray
+// is tested against 4 (SSE) or 8 (AVX) of them at once, see
+// Config.hpp for the instruction set.
+////////////////////////////////////////////////////////////
+class ZOOM_API SegmentBuffer
+{
+public:
+
+    ////////////////////////////////////////////////////////////
+    // Remove all the segments
+    ////////////////////////////////////////////////////////////
+    void clear();
+
+    ////////////////////////////////////////////////////////////
+    // Add a segment
+    ////////////////////////////////////////////////////////////
+    void push(const Segment& segment);
+
+    ////////////////////////////////////////////////////////////
+    // Add a segment
+    ////////////////////////////////////////////////////////////
+    void push(float x1, float y1, float x2, float y2);
+
+    ////////////////////////////////////////////////////////////
+    // Remove a segment, the last one takes its place
+    ////////////////////////////////////////////////////////////
+    void remove(size_t indice);
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of segments
+    ////////////////////////////////////////////////////////////
+    size_t getSize() const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the distance along a ray starting at the origin to
+    // every segment, infinity for the segments it misses
+    ////////////////////////////////////////////////////////////
+    void intersect(float dx, float dy, float* distances) const;
+
+    ////////////////////////////////////////////////////////////
+    // Same as intersect, one segment at a time, the reference
+    // the SIMD kernels are checked against
+    ////////////////////////////////////////////////////////////
+    void intersectScalar(float dx, float dy, float* distances) const;
+
+    ////////////////////////////////////////////////////////////
+    // Flag the segments from begin lying entirely beyond one of
+    // the sides of a triangle, culled[k - begin] is 1 for them
+    ////////////////////////////////////////////////////////////
+    void cull(const Point& a, const Point& b, const Point& c, size_t begin, Uint8* culled) const;
+
+    ////////////////////////////////////////////////////////////
+    // Same as cull, one segment at a time, the reference the
+    // SIMD kernels are checked against
+    ////////////////////////////////////////////////////////////
+    void cullScalar(const Point& a, const Point& b, const Point& c, size_t begin, Uint8* culled) const;
+
+private:
+
+    ////////////////////////////////////////////////////////////
+    // Sides structure, the lines bounding a triangle with the
+    // tolerance on the side of a point
+    ////////////////////////////////////////////////////////////
+    struct Sides
+    {
+        float x[3];
+        float y[3];
+        float dx[3];
+        float dy[3];
+        float limit[3];
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Get the sides of a triangle, counterclockwise, false if
+    // it is flat
+    ////////////////////////////////////////////////////////////
+    static bool getSides(const Point& a, const Point& b, const Point& c, Sides& sides);
+
+    ////////////////////////////////////////////////////////////
+    // Intersect the segments from begin to the end, one by one
+    ////////////////////////////////////////////////////////////
+    void intersectScalar(float dx, float dy, float* distances, size_t begin) const;
+
+    ////////////////////////////////////////////////////////////
+    // Cull the segments from first to the end, one by one
+    ////////////////////////////////////////////////////////////
+    void cullScalar(const Sides& sides, size_t begin, size_t first, Uint8* culled) const;
+
+    ////////////////////////////////////////////////////////////
+    // Member data
+    ////////////////////////////////////////////////////////////
+    std::vector<float> m_x1,
+                       m_y1,
+                       m_x2,
+                       m_y2;
+};
+
+}
+
+#endif // ZOOM_SEGMENT_BUFFER_HPP
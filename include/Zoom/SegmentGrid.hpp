@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#ifndef ZOOM_SEGMENT_GRID_HPP
+#define ZOOM_SEGMENT_GRID_HPP
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <vector>
+#include <unordered_map>
+#include <Zoost/Segment.hpp>
+#include <Zoost/Vector2.hpp>
+#include <Zoom/Config.hpp>
+
+namespace zin
+{
+
+class ZOOM_API SegmentGrid
+{
+public:
+
+    ////////////////////////////////////////////////////////////
+    // Default constructor
+    ////////////////////////////////////////////////////////////
+    SegmentGrid(double cellSize = 128);
+
+    ////////////////////////////////////////////////////////////
+    // Set the size of the cells, the grid is cleared. A size
+    // which is not positive is ignored
+    ////////////////////////////////////////////////////////////
+    void setCellSize(double cellSize);
+
+    ////////////////////////////////////////////////////////////
+    // Get the size of the cells
+    ////////////////////////////////////////////////////////////
+    double getCellSize() const;
+
+    ////////////////////////////////////////////////////////////
+    // Remove all the segments, the cells keep their memory
+    ////////////////////////////////////////////////////////////
+    void clear();
+
+    ////////////////////////////////////////////////////////////
+    // Insert a segment, its indice is the insertion order
+    ////////////////////////////////////////////////////////////
+    void insert(const Segment& segment);
+
+    ////////////////////////////////////////////////////////////
+    // Remove a segment from its cells, its indice stays taken
+    // until the grid is cleared
+    ////////////////////////////////////////////////////////////
+    void remove(Uint32 indice);
+
+    ////////////////////////////////////////////////////////////
+    // Return true if the segment of an indice was removed
+    ////////////////////////////////////////////////////////////
+    bool isRemoved(size_t indice) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of segments removed since the last clear
+    ////////////////////////////////////////////////////////////
+    size_t getRemovedCount() const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the indices of the segments in the cells overlapping
+    // the box around a circle, sorted and without duplicates
+    ////////////////////////////////////////////////////////////
+    void query(const Point& center, double radius, std::vector<Uint32>& indices) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the indices of the segments in the cells overlapping
+    // a box, sorted and without duplicates
+    ////////////////////////////////////////////////////////////
+    void query(const Point& min, const Point& max, std::vector<Uint32>& indices) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the segment specified by its indice
+    ////////////////////////////////////////////////////////////
+    const Segment& getSegment(size_t indice) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the segments
+    ////////////////////////////////////////////////////////////
+    const std::vector<Segment>& getSegments() const;
+
+private:
+
+    ////////////////////////////////////////////////////////////
+    // Get the key of a cell
+    ////////////////////////////////////////////////////////////
+    static Int64 getKey(Int64 x, Int64 y);
+
+    ////////////////////////////////////////////////////////////
+    // Get the keys of the cells crossed by a segment
+    ////////////////////////////////////////////////////////////
+    void getKeys(const Segment& segment, std::vector<Int64>& keys) const;
+
+    ////////////////////////////////////////////////////////////
+    // Member data
+    ////////////////////////////////////////////////////////////
+    double                                            m_cellSize;
+    size_t                                            m_removedCount;
+    std::vector<Segment>                              m_segments;
+    std::vector<bool>                                 m_isRemoved;
+    std::unordered_map<Int64, std::vector<Uint32>>    m_cells;
+    std::vector<Int64>                                m_keys;
+};
+
+}
+
+#endif // ZOOM_SEGMENT_GRID_HPP
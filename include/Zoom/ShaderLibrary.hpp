@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#ifndef ZOOM_SHADER_LIBRARY_HPP
+#define ZOOM_SHADER_LIBRARY_HPP
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <SFML/Graphics.hpp>
+#include <Zoom/Config.hpp>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+// Shaders shared by the lights, the shapes and the light
+// manager. Each one is compiled on its first use, which needs
+// an OpenGL context such as a window, and a failure to compile
+// is final: the lights and the shapes asking for a shader
+// before a context exists keep their fallback for good.
+////////////////////////////////////////////////////////////
+class ZOOM_API ShaderLibrary
+{
+public:
+
+    ////////////////////////////////////////////////////////////
+    // Get the shader extruding the occluder quads away from a
+    // light, null if the shaders are not available
+    ////////////////////////////////////////////////////////////
+    static sf::Shader* getShadowVolume();
+
+    ////////////////////////////////////////////////////////////
+    // Get the shader writing the distance to the nearest
+    // occluder for every angle around a light
+    ////////////////////////////////////////////////////////////
+    static sf::Shader* getPolarMap();
+
+    ////////////////////////////////////////////////////////////
+    // Get the shader lighting a disc with its polar map row
+    ////////////////////////////////////////////////////////////
+    static sf::Shader* getPolarShading();
+
+    ////////////////////////////////////////////////////////////
+    // Get the shader attenuating a light per pixel
+    ////////////////////////////////////////////////////////////
+    static sf::Shader* getFalloff();
+
+    ////////////////////////////////////////////////////////////
+    // Get the shader cutting a disc out of a quad, for the
+    // markers of the shapes
+    ////////////////////////////////////////////////////////////
+    static sf::Shader* getRoundPoint();
+
+private:
+
+    ////////////////////////////////////////////////////////////
+    // Load a shader, return null if it fails
+    ////////////////////////////////////////////////////////////
+    static sf::Shader* load(sf::Shader& shader, const char* vertex, const char* fragment);
+};
+
+}
+
+#endif // ZOOM_SHADER_LIBRARY_HPP
@@ -32,6 +32,7 @@
 #include <Zoost/Geom.hpp>
 #include <Zoost/Curve.hpp>
 #include <Zoom/Color.hpp>
+#include <Zoom/Stroker.hpp>
 #include <Zoom/Config.hpp>
 
 namespace zin
@@ -72,7 +73,9 @@ public:
     };
     
     ////////////////////////////////////////////////////////////
-    // Default constructor
+    // Default constructor. The markers are quads rounded by a
+    // shader if it is available at this point (see ShaderLibrary),
+    // otherwise circles of 40 triangles
     ////////////////////////////////////////////////////////////
 	Shape(Geom& geom);
 
@@ -131,6 +134,17 @@ public:
     ////////////////////////////////////////////////////////////
     void setLiaisonWidth(size_t indice, Uint16 size);
 
+    ////////////////////////////////////////////////////////////
+    // Set the join filling the gap where a vertex links exactly
+    // two liaisons
+    ////////////////////////////////////////////////////////////
+    void setLiaisonsJoin(Stroker::Join join);
+
+    ////////////////////////////////////////////////////////////
+    // Get the join between two liaisons
+    ////////////////////////////////////////////////////////////
+    Stroker::Join getLiaisonsJoin() const;
+
     ////////////////////////////////////////////////////////////
     // Show or hide the vertices
     ////////////////////////////////////////////////////////////
@@ -240,26 +254,106 @@ protected:
 
 private:
 
+    ////////////////////////////////////////////////////////////
+    // Index the liaisons and faces of every vertex, and cache the
+    // coordinates of the vertices
+    ////////////////////////////////////////////////////////////
+    void link() const;
+
+    ////////////////////////////////////////////////////////////
+    // Write the vertices of a face into its place in the array
+    ////////////////////////////////////////////////////////////
+    void writeFace(size_t indice) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the normal of a liaison, as long as its width
+    ////////////////////////////////////////////////////////////
+    sf::Vector2f getNormal(size_t indice) const;
+
+    ////////////////////////////////////////////////////////////
+    // Write the vertices of a liaison into its place in the array
+    ////////////////////////////////////////////////////////////
+    void writeLiaison(size_t indice, const sf::Vector2f& normal) const;
+
+    ////////////////////////////////////////////////////////////
+    // Write the join of a vertex into its place in the array,
+    // from the normals of its two liaisons
+    ////////////////////////////////////////////////////////////
+    void writeJoin(size_t indice, const sf::Vector2f& first, const sf::Vector2f& second) const;
+
+    ////////////////////////////////////////////////////////////
+    // Write the join of a vertex if it links two liaisons
+    ////////////////////////////////////////////////////////////
+    void updateJoin(size_t indice) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of vertices of a marker
+    ////////////////////////////////////////////////////////////
+    Uint32 getMarkerSize() const;
+
+    ////////////////////////////////////////////////////////////
+    // Write the marker of a vertex into its place in the array,
+    // a quad cut round by the shader or a circle of triangles
+    ////////////////////////////////////////////////////////////
+    void writeMarker(size_t indice) const;
+
+    ////////////////////////////////////////////////////////////
+    // Update the debug wireframe of the faces and liaisons
+    ////////////////////////////////////////////////////////////
+    void updateWireframe() const;
+
+    ////////////////////////////////////////////////////////////
+    // Copy the colors into the arrays without moving the vertices
+    ////////////////////////////////////////////////////////////
+    void updateColors() const;
+
+    ////////////////////////////////////////////////////////////
+    // Update the debug overlays, in global coordinates
+    ////////////////////////////////////////////////////////////
+    void updateDebug() const;
+
     ////////////////////////////////////////////////////////////
     // Member data
     ////////////////////////////////////////////////////////////
     bool                                 m_debugMode;
     Geom&                                m_geom;
-    mutable std::vector<sf::VertexArray> m_vertexArray;
-    mutable std::vector<sf::VertexArray> m_vertexArrayDebug;
+    mutable sf::VertexArray              m_faces;
+    mutable sf::VertexArray              m_liaisons;
+    mutable sf::VertexArray              m_joins;
+    mutable sf::VertexArray              m_markers;
+    mutable sf::VertexArray              m_wireframe;
+    mutable sf::VertexArray              m_vertexArrayDebug;
     mutable bool                         m_needUpdate,
+                                         m_needRecolor,
+                                         m_needDebugUpdate,
+                                         m_needMove,
                                          m_isVertexShowed,
                                          m_isLiaisonShowed,
                                          m_isFaceShowed,
                                          m_isFaceColorEnabled;
+    bool                                 m_isMarkerShaded;
 	Color  		   	                     m_defaultVertexColor,
 		   			                     m_defaultLiaisonColor,
                                          m_defaultFaceColor;
 	Uint16 			                     m_defaultLiaisonWidth,
 		   			                     m_defaultVertexSize;
+    Stroker::Join                        m_join;
+    mutable Stroker                      m_stroker;
 	std::vector<VertexInfo>              m_vertexInfos;
     std::vector<LiaisonInfo>             m_liaisonInfos;
     std::vector<FaceInfo>                m_faceInfos;
+    mutable std::vector<Uint32>          m_faceOffsets;
+    mutable std::vector<Uint32>          m_liaisonOffsets;
+    mutable std::vector<Uint32>          m_markerOffsets;
+    mutable std::vector<Uint32>          m_joinOffsets;
+    mutable std::vector<Uint32>          m_dirtyFaces;
+    mutable std::vector<Uint32>          m_dirtyLiaisons;
+    mutable std::vector<Uint32>          m_dirtyVertices;
+    mutable std::vector<Point>           m_coords;
+    mutable std::vector<Uint32>          m_liaisonStarts;
+    mutable std::vector<Uint32>          m_liaisonLinks;
+    mutable std::vector<Uint32>          m_faceStarts;
+    mutable std::vector<Uint32>          m_faceLinks;
 };
 
 }
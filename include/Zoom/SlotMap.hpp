@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+
+#ifndef ZOOM_SLOT_MAP_HPP
+#define ZOOM_SLOT_MAP_HPP
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <Zoom/Config.hpp>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+// Handle to a value of a slot map, the type only tells the
+// handles of distinct maps apart
+////////////////////////////////////////////////////////////
+template <typename T>
+struct Handle
+{
+    Uint32 slot = 0;
+    Uint32 generation = 0;
+
+    ////////////////////////////////////////////////////////////
+    // Return false for a default handle
+    ////////////////////////////////////////////////////////////
+    bool isValid() const { return generation != 0; }
+
+    bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+////////////////////////////////////////////////////////////
+// Values stored contiguously, inserted and removed in constant
+// time, and reached through handles which stay valid until
+// their value is removed
+////////////////////////////////////////////////////////////
+template <typename Key, typename T>
+class SlotMap
+{
+public:
+
+    typedef typename std::vector<T>::iterator       Iterator;
+    typedef typename std::vector<T>::const_iterator ConstIterator;
+
+    ////////////////////////////////////////////////////////////
+    // Insert a value
+    ////////////////////////////////////////////////////////////
+    Handle<Key> insert(T value)
+    {
+        Uint32 slot;
+
+        if( m_free.empty() )
+        {
+            slot = m_slots.size();
+            m_slots.push_back(Slot{0, 1});
+        }
+
+        else
+        {
+            slot = m_free.back();
+            m_free.pop_back();
+        }
+
+        m_slots[slot].dense = m_values.size();
+        m_values.push_back(std::move(value));
+        m_owners.push_back(slot);
+
+        Handle<Key> handle;
+        handle.slot = slot;
+        handle.generation = m_slots[slot].generation;
+
+        return handle;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Remove a value, the last one takes its place
+    ////////////////////////////////////////////////////////////
+    bool remove(Handle<Key> handle)
+    {
+        if( !contains(handle) )
+            return false;
+
+        Uint32 dense = m_slots[handle.slot].dense;
+
+        if( dense + 1 != m_values.size() )
+        {
+            m_values[dense] = std::move(m_values.back());
+            m_owners[dense] = m_owners.back();
+            m_slots[m_owners[dense]].dense = dense;
+        }
+
+        m_values.pop_back();
+        m_owners.pop_back();
+
+        // The next handles of this slot won't match the old ones
+
+        if( ++m_slots[handle.slot].generation == 0 )
+            m_slots[handle.slot].generation = 1;
+
+        m_free.push_back(handle.slot);
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Return true if the value of a handle is still stored
+    ////////////////////////////////////////////////////////////
+    bool contains(Handle<Key> handle) const
+    {
+        return handle.isValid() && handle.slot < m_slots.size() && m_slots[handle.slot].generation == handle.generation;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Get the value of a handle, null if it was removed
+    ////////////////////////////////////////////////////////////
+    T* get(Handle<Key> handle)
+    {
+        return contains(handle) ? &m_values[m_slots[handle.slot].dense] : nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of values
+    ////////////////////////////////////////////////////////////
+    size_t getSize() const
+    {
+        return m_values.size();
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Iterate over the values, in no particular order
+    ////////////////////////////////////////////////////////////
+    Iterator begin() { return m_values.begin(); }
+    Iterator end() { return m_values.end(); }
+    ConstIterator begin() const { return m_values.begin(); }
+    ConstIterator end() const { return m_values.end(); }
+
+private:
+
+    ////////////////////////////////////////////////////////////
+    // Slot structure, where the value of a handle lies
+    ////////////////////////////////////////////////////////////
+    struct Slot
+    {
+        Uint32 dense;
+        Uint32 generation;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Member data
+    ////////////////////////////////////////////////////////////
+    std::vector<T>      m_values;
+    std::vector<Uint32> m_owners;
+    std::vector<Slot>   m_slots;
+    std::vector<Uint32> m_free;
+};
+
+}
+
+#endif // ZOOM_SLOT_MAP_HPP
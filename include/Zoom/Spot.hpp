@@ -44,9 +44,16 @@ public:
 	Spot(double radius = 100, double aperture = .785398163f, Color color = Color(255, 255, 255, 200), Uint32 complexity = 4);
     
     ////////////////////////////////////////////////////////////
-    // Generate the spot
+    // Get the aperture of the spot
     ////////////////////////////////////////////////////////////
-	void generate(const std::vector<Segment>& segments);
+    double getAperture() const;
+
+protected:
+
+    ////////////////////////////////////////////////////////////
+    // Return true if a local segment is in the cone of the spot
+    ////////////////////////////////////////////////////////////
+    bool isInReach(const Segment& segment) const;
 
 private:
     
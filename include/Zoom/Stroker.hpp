@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+
+#ifndef ZOOM_STROKER_HPP
+#define ZOOM_STROKER_HPP
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include <Zoost/Vector2.hpp>
+#include <Zoom/Config.hpp>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+// Edges of thick lines stored as separate arrays of floats, so
+// that their normals are computed 4 (SSE) or 8 (AVX) at once,
+// and the joins filling the gaps between them, see Config.hpp
+// for the instruction set.
+////////////////////////////////////////////////////////////
+class ZOOM_API Stroker
+{
+public:
+
+    ////////////////////////////////////////////////////////////
+    // Shape of the joins between two edges
+    ////////////////////////////////////////////////////////////
+    enum Join
+    {
+        None,  // Leave the gap open
+        Miter, // Extend the outer sides until they meet
+        Bevel, // Cut the corner between the outer sides
+        Round  // Round the corner between the outer sides
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Remove all the edges
+    ////////////////////////////////////////////////////////////
+    void clear();
+
+    ////////////////////////////////////////////////////////////
+    // Add an edge, offset by the width on both sides
+    ////////////////////////////////////////////////////////////
+    void push(const Point& p1, const Point& p2, float width);
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of edges
+    ////////////////////////////////////////////////////////////
+    size_t getSize() const;
+
+    ////////////////////////////////////////////////////////////
+    // Compute the normals of all the edges
+    ////////////////////////////////////////////////////////////
+    void computeNormals();
+
+    ////////////////////////////////////////////////////////////
+    // Get the normal of an edge, on its left and as long as its
+    // width, once the normals are computed
+    ////////////////////////////////////////////////////////////
+    sf::Vector2f getNormal(size_t indice) const;
+
+    ////////////////////////////////////////////////////////////
+    // Get the normal of a single edge, null for an empty edge
+    ////////////////////////////////////////////////////////////
+    static sf::Vector2f getNormal(const Point& p1, const Point& p2, float width);
+
+    ////////////////////////////////////////////////////////////
+    // Get the number of triangle vertices taken by a join
+    ////////////////////////////////////////////////////////////
+    static Uint32 getJoinSize(Join join);
+
+    ////////////////////////////////////////////////////////////
+    // Write the triangles of a join at a point, from the normal
+    // of the edge coming in to the normal of the edge going out,
+    // on the outer side of the turn. The vertices left unused are
+    // flattened on the point.
+    ////////////////////////////////////////////////////////////
+    static void writeJoin(sf::Vertex* vertices, Join join, const sf::Vector2f& point, const sf::Vector2f& in, const sf::Vector2f& out, const sf::Color& color);
+
+private:
+
+    ////////////////////////////////////////////////////////////
+    // Compute the normals from begin to the end, one by one
+    ////////////////////////////////////////////////////////////
+    void computeNormalsScalar(size_t begin);
+
+    ////////////////////////////////////////////////////////////
+    // Member data
+    ////////////////////////////////////////////////////////////
+    std::vector<float> m_dx,
+                       m_dy,
+                       m_widths,
+                       m_nx,
+                       m_ny;
+};
+
+}
+
+#endif // ZOOM_STROKER_HPP
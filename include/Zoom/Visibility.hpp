@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#ifndef ZOOM_VISIBILITY_HPP
+#define ZOOM_VISIBILITY_HPP
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <vector>
+#include <Zoost/Segment.hpp>
+#include <Zoost/Vector2.hpp>
+#include <Zoom/Config.hpp>
+#include <Zoom/SegmentBuffer.hpp>
+
+namespace zin
+{
+
+class ZOOM_API Visibility
+{
+public:
+
+    ////////////////////////////////////////////////////////////
+    // Compute the visibility polygon of the sector [0, aperture]
+    // seen from the origin, bounded by the regular polygon of
+    // the given complexity inscribed in the radius. The segments
+    // must be in the local coordinates of the viewer. The output
+    // receives one pair of points per lit triangle.
+    //
+    // The edges crossed by the ray are kept in a flat buffer
+    // scanned at every event, so the cost is O(n log n + (n + c) k)
+    // for n edges, c crossings between them and at most k edges
+    // overlapping along a ray. It stays near linear for the usual
+    // scenes where few walls stack up behind each other, and turns
+    // quadratic when every edge overlaps every other one.
+    ////////////////////////////////////////////////////////////
+    void compute(const std::vector<Segment>& segments, double radius, double aperture, Uint32 complexity, std::vector<Point>& output);
+
+private:
+
+    ////////////////////////////////////////////////////////////
+    // Edge structure
+    ////////////////////////////////////////////////////////////
+    struct Edge
+    {
+        Point  p1;
+        Point  p2;
+        double begin;
+        double end;
+    };
+
+    ////////////////////////////////////////////////////////////
+    // Add a segment, split on the first ray and clamped to the aperture
+    ////////////////////////////////////////////////////////////
+    void addSegment(Point p1, Point p2, double aperture);
+
+    ////////////////////////////////////////////////////////////
+    // Add an edge spanning [begin, end], clamped to the aperture
+    ////////////////////////////////////////////////////////////
+    void addEdge(const Point& p1, Point p2, double begin, double end, double aperture);
+
+    ////////////////////////////////////////////////////////////
+    // Get the nearest active edge in the direction of the angle
+    ////////////////////////////////////////////////////////////
+    size_t getNearest(double angle, double next);
+
+    ////////////////////////////////////////////////////////////
+    // Get the distance from the origin to an edge along a ray
+    ////////////////////////////////////////////////////////////
+    static double getDistance(const Edge& edge, double angle);
+
+    ////////////////////////////////////////////////////////////
+    // Get the point hit by a ray on an edge
+    ////////////////////////////////////////////////////////////
+    static Point getHit(const Edge& edge, double angle);
+
+    ////////////////////////////////////////////////////////////
+    // Get the angle of a point in [0, 2pi)
+    ////////////////////////////////////////////////////////////
+    static double getAngle(const Point& point);
+
+    ////////////////////////////////////////////////////////////
+    // Member data
+    ////////////////////////////////////////////////////////////
+    std::vector<Edge>   m_edges;
+    std::vector<size_t> m_active;
+    SegmentBuffer       m_activeBuffer;
+    std::vector<float>  m_distances;
+    std::vector<double> m_events;
+};
+
+}
+
+#endif // ZOOM_VISIBILITY_HPP
@@ -23,17 +23,36 @@
 ////////////////////////////////////////////////////////////
 
 #include <Zoom/Light.hpp>
+#include <Zoom/ShaderLibrary.hpp>
+#include <algorithm>
+#include <cmath>
 
 namespace zin
 {
 	
 ////////////////////////////////////////////////////////////
 Light::Light(double radius, Color color, Uint32 complexity) :
-m_color(color),
+m_debugMode(false),
+m_needUpdate(false),
+m_isOutdated(true),
 m_radius(radius),
+m_color(color),
 m_complexity(complexity),
-m_debugMode(false),
-m_needUpdate(false) {}
+m_isComplexityAdaptive(false),
+m_minComplexity(4),
+m_maxComplexity(128),
+m_algorithm(Sweep),
+m_falloff(Linear),
+m_isShaded(ShaderLibrary::getFalloff() != nullptr),
+m_vertexArray(sf::Triangles),
+m_vertexArrayWireframe(sf::Lines),
+m_vertexArrayDebug(sf::Lines)
+{
+    const double identity[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+
+    std::copy(identity, identity + 9, m_fanTransform);
+    std::copy(identity, identity + 9, m_nextFanTransform);
+}
 
 ////////////////////////////////////////////////////////////
 void Light::setDebugMode(bool enabled)
@@ -51,114 +70,414 @@ bool Light::getDebugMode()
     return m_debugMode;
 }
 
+////////////////////////////////////////////////////////////
+void Light::setAlgorithm(Algorithm algorithm)
+{
+    if( m_algorithm != algorithm )
+    {
+        m_algorithm = algorithm;
+        m_isOutdated = true;
+    }
+}
+
+////////////////////////////////////////////////////////////
+Light::Algorithm Light::getAlgorithm() const
+{
+    return m_algorithm;
+}
+
+////////////////////////////////////////////////////////////
+void Light::setFalloff(Falloff falloff)
+{
+    if( m_falloff != falloff )
+    {
+        m_falloff = falloff;
+        m_isOutdated = true;
+    }
+}
+
+////////////////////////////////////////////////////////////
+Light::Falloff Light::getFalloff() const
+{
+    return m_falloff;
+}
+
+////////////////////////////////////////////////////////////
+void Light::setComplexity(Uint32 complexity)
+{
+    if( m_complexity != complexity )
+    {
+        m_complexity = complexity;
+        m_isOutdated = true;
+    }
+}
+
+////////////////////////////////////////////////////////////
+Uint32 Light::getComplexity() const
+{
+    return m_complexity;
+}
+
+////////////////////////////////////////////////////////////
+void Light::enableAdaptiveComplexity(bool enabled, Uint32 minComplexity, Uint32 maxComplexity)
+{
+    m_isComplexityAdaptive = enabled;
+    m_minComplexity = std::max(1u, minComplexity);
+    m_maxComplexity = std::max(m_minComplexity, maxComplexity);
+}
+
+////////////////////////////////////////////////////////////
+void Light::adaptComplexity(double scale)
+{
+    if( !m_isComplexityAdaptive )
+        return;
+
+    // Keep the gap between the arc and the polygon under half a pixel
+
+    double radius = getGlobalRadius() * scale, error = .5;
+    double minimum = m_minComplexity, maximum = m_maxComplexity;
+
+    // With the shader the arc is exact whatever the number of wedges,
+    // as long as they are narrow enough for the polygon to circumscribe it
+
+    if( m_isShaded )
+        minimum = std::max(minimum, std::floor(getAperture() / 2) + 1);
+
+    maximum = std::max(minimum, maximum);
+
+    double complexity = minimum;
+
+    if( radius > error && !m_isShaded )
+        complexity = std::ceil(getAperture() / (2 * std::acos(1 - error / radius)));
+
+    complexity = std::max(minimum, std::min(maximum, complexity));
+
+    // Small zoom changes don't trigger a new generation
+
+    if( complexity < m_complexity * .8 || complexity > m_complexity * 1.25 || m_complexity < minimum || m_complexity > maximum )
+        setComplexity(complexity);
+}
+
+////////////////////////////////////////////////////////////
+void Light::setRadius(double radius)
+{
+    if( m_radius != radius )
+    {
+        m_radius = radius;
+        m_isOutdated = true;
+    }
+}
+
+////////////////////////////////////////////////////////////
+double Light::getRadius() const
+{
+    return m_radius;
+}
+
+////////////////////////////////////////////////////////////
+void Light::setColor(const Color& color)
+{
+    if( m_color != color )
+    {
+        m_color = color;
+        m_isOutdated = true;
+    }
+}
+
+////////////////////////////////////////////////////////////
+const Color& Light::getColor() const
+{
+    return m_color;
+}
+
+////////////////////////////////////////////////////////////
+double Light::getAperture() const
+{
+    return 6.28318531f;
+}
+
+////////////////////////////////////////////////////////////
+Point Light::getGlobalCenter() const
+{
+    return convertToGlobal(Point(0, 0));
+}
+
+////////////////////////////////////////////////////////////
+double Light::getGlobalRadius() const
+{
+    Point center = convertToGlobal(Point(0, 0)),
+          p1 = convertToGlobal(Point(m_radius, 0)),
+          p2 = convertToGlobal(Point(0, m_radius));
+
+    return std::max(Point(p1.x - center.x, p1.y - center.y).length(), Point(p2.x - center.x, p2.y - center.y).length());
+}
+
+////////////////////////////////////////////////////////////
+bool Light::reaches(const Segment& segment) const
+{
+    return isInReach(convertToLocal(segment));
+}
+
+////////////////////////////////////////////////////////////
+bool Light::isInReach(const Segment& s) const
+{
+    double dx = s.p2.x - s.p1.x, dy = s.p2.y - s.p1.y, length = dx * dx + dy * dy;
+    double t = length > 0 ? -(s.p1.x * dx + s.p1.y * dy) / length : 0;
+
+    t = std::max(0., std::min(1., t));
+
+    return Point(s.p1.x + dx * t, s.p1.y + dy * t).length() <= m_radius;
+}
+
+////////////////////////////////////////////////////////////
+bool Light::isOutdated() const
+{
+    return m_isOutdated;
+}
+
+////////////////////////////////////////////////////////////
+const std::vector<sf::Vector2f>& Light::getFan() const
+{
+    return m_fan;
+}
+
+////////////////////////////////////////////////////////////
+void Light::exportTo(Geom& geom) const
+{
+    geom.clear();
+
+    Vertex& center = geom.addVertex(Point(m_fanTransform[2], m_fanTransform[5]));
+
+    sf::Transform transform = getRenderTransform();
+
+    for( size_t k(0); k + 1 < m_fan.size(); k+=2 )
+    {
+        sf::Vector2f p1 = transform.transformPoint(m_fan[k]), p2 = transform.transformPoint(m_fan[k + 1]);
+
+        Vertex& v1 = geom.addVertex(Point(p1.x, p1.y));
+        Vertex& v2 = geom.addVertex(Point(p2.x, p2.y));
+
+        geom.addFace(center, v1, v2);
+    }
+}
+
 ////////////////////////////////////////////////////////////
 void Light::update() const
 {
     if( m_needUpdate )
     {
-        m_vertexArray.clear();
+        // Resizing keeps the storage of the arrays, so nothing is
+        // allocated once they reached their size
+
+        size_t count = m_fan.size() / 2;
+
+        m_vertexArray.resize(count * 3);
+        m_vertexArrayWireframe.clear();
         m_vertexArrayDebug.clear();
 
-        for( size_t k(0); k < getFacesCount(); k++ )
+        for( size_t k(0); k < count; k++ )
         {
-            Face& face = getFace(k);
-
-            Vector2d p1 = face.v1.getCoords();
-            Vector2d p2 = face.v2.getCoords();
-            Vector2d p3 = face.v3.getCoords();
-                    
-            sf::VertexArray array(sf::Triangles, 3);
-
-            array[0].position = sf::Vector2f(p1.x, p1.y);
-            array[1].position = sf::Vector2f(p2.x, p2.y);
-            array[2].position = sf::Vector2f(p3.x, p3.y);
-
-            array[0].color = m_colors[face.v1.getIndice()];
-            array[1].color = m_colors[face.v2.getIndice()];
-            array[2].color = m_colors[face.v3.getIndice()];
-                    
-            m_vertexArray.push_back(array);
+            const sf::Vector2f& p1 = m_fan[k * 2];
+            const sf::Vector2f& p2 = m_fan[k * 2 + 1];
+
+            // With the shader, the attenuation comes from the position
+            // relative to the radius carried by the texture coordinates
+
+            if( m_isShaded )
+            {
+                m_vertexArray[k * 3]     = sf::Vertex(sf::Vector2f(0, 0), m_color, sf::Vector2f(0, 0));
+                m_vertexArray[k * 3 + 1] = sf::Vertex(p1, m_color, p1 / static_cast<float>(m_radius));
+                m_vertexArray[k * 3 + 2] = sf::Vertex(p2, m_color, p2 / static_cast<float>(m_radius));
+            }
+
+            else
+            {
+                m_vertexArray[k * 3]     = sf::Vertex(sf::Vector2f(0, 0), m_color);
+                m_vertexArray[k * 3 + 1] = sf::Vertex(p1, getShade(p1));
+                m_vertexArray[k * 3 + 2] = sf::Vertex(p2, getShade(p2));
+            }
         }
 
         if( m_debugMode )
         {
-            for( size_t k(0); k < getFacesCount(); k++ )
+            Point center(m_fanTransform[2], m_fanTransform[5]), min = center, max = center;
+
+            for( size_t k(0); k < count; k++ )
             {
-                Face& face = getFace(k);
+                sf::Vector2f points[] = {sf::Vector2f(0, 0), m_fan[k * 2], m_fan[k * 2 + 1]};
 
-                Vector2d p1 = face.v1.getCoords();
-                Vector2d p2 = face.v2.getCoords();
-                Vector2d p3 = face.v3.getCoords();
-                    
-                sf::VertexArray lines(sf::LinesStrip, 4);
+                for( size_t i(0); i < 3; i++ )
+                {
+                    m_vertexArrayWireframe.append(sf::Vertex(points[i], sf::Color::White));
+                    m_vertexArrayWireframe.append(sf::Vertex(points[(i + 1) % 3], sf::Color::White));
+                }
+            }
 
-                lines[0].position = sf::Vector2f(p1.x, p1.y);
-                lines[1].position = sf::Vector2f(p2.x, p2.y);
-                lines[2].position = sf::Vector2f(p3.x, p3.y);
-                lines[3].position = sf::Vector2f(p1.x, p1.y);
+            sf::Transform transform = getRenderTransform();
 
-                lines[0].color = sf::Color::White;
-                lines[1].color = sf::Color::White;
-                lines[2].color = sf::Color::White;
-                lines[3].color = sf::Color::White;
+            for( auto& point : m_fan )
+            {
+                sf::Vector2f global = transform.transformPoint(point);
+                Point p(global.x, global.y);
 
-                m_vertexArray.push_back(lines);
+                min.x = std::min(min.x, p.x);
+                min.y = std::min(min.y, p.y);
+                max.x = std::max(max.x, p.x);
+                max.y = std::max(max.y, p.y);
             }
 
-            const Rect& rect = getGlobalBounds();
             Point origin = convertToGlobal(getOrigin());
 
-            sf::VertexArray circle(sf::LinesStrip, 10);
-
             double angus = 0;
                 
-            for( size_t k(0); k < 10; k++ )
+            for( size_t k(0); k < 9; k++ )
             {
-                circle[k].position = sf::Vector2f(origin.x + std::cos(angus) * 11, origin.y + std::sin(angus) * 11);
-                circle[k].color = sf::Color::Red;
+                m_vertexArrayDebug.append(sf::Vertex(sf::Vector2f(origin.x + std::cos(angus) * 11, origin.y + std::sin(angus) * 11), sf::Color::Red));
                 angus+=.698131701f;
+                m_vertexArrayDebug.append(sf::Vertex(sf::Vector2f(origin.x + std::cos(angus) * 11, origin.y + std::sin(angus) * 11), sf::Color::Red));
+            }
+
+            sf::Vector2f corners[] = {sf::Vector2f(min.x - 1, min.y - 1),
+                                      sf::Vector2f(max.x + 1, min.y - 1),
+                                      sf::Vector2f(max.x + 1, max.y + 1),
+                                      sf::Vector2f(min.x - 1, max.y + 1)};
+
+            for( size_t k(0); k < 4; k++ )
+            {
+                m_vertexArrayDebug.append(sf::Vertex(corners[k], sf::Color::Red));
+                m_vertexArrayDebug.append(sf::Vertex(corners[(k + 1) % 4], sf::Color::Red));
             }
+        }
 
-            m_vertexArrayDebug.push_back(circle);
+        m_needUpdate = false;
+    }
+}
 
-            sf::VertexArray lines(sf::LinesStrip, 5);
+////////////////////////////////////////////////////////////
+sf::Color Light::getShade(const sf::Vector2f& point) const
+{
+    double length = std::sqrt(point.x * point.x + point.y * point.y);
 
-            lines[0].position = sf::Vector2f(rect.pos.x - 1, rect.pos.y - 1);
-            lines[1].position = sf::Vector2f(rect.pos.x + rect.size.x + 1, rect.pos.y - 1);
-            lines[2].position = sf::Vector2f(rect.pos.x + rect.size.x + 1, rect.pos.y + rect.size.y + 1);
-            lines[3].position = sf::Vector2f(rect.pos.x - 1, rect.pos.y + rect.size.y + 1);
-            lines[4].position = sf::Vector2f(rect.pos.x - 1, rect.pos.y - 1);
+    return sf::Color(m_color.r, m_color.g, m_color.b, char(255*(m_radius - length) / m_radius));
+}
 
-            lines[0].color = sf::Color::Red;
-            lines[1].color = sf::Color::Red;
-            lines[2].color = sf::Color::Red;
-            lines[3].color = sf::Color::Red;
-            lines[4].color = sf::Color::Red;
+////////////////////////////////////////////////////////////
+void Light::appendTo(sf::VertexArray& batch) const
+{
+    update();
 
-            m_vertexArrayDebug.push_back(lines);
-        }
+    sf::Transform transform = getRenderTransform();
 
-        m_needUpdate = false;
+    for( size_t k(0); k < m_vertexArray.getVertexCount(); k++ )
+    {
+        const sf::Vertex& vertex = m_vertexArray[k];
+        batch.append(sf::Vertex(transform.transformPoint(vertex.position), vertex.color, vertex.texCoords));
     }
 }
 
+////////////////////////////////////////////////////////////
+sf::Transform Light::getRenderTransform() const
+{
+    const double* values = m_fanTransform;
+
+    return sf::Transform(static_cast<float>(values[0]), static_cast<float>(values[1]), static_cast<float>(values[2]),
+                         static_cast<float>(values[3]), static_cast<float>(values[4]), static_cast<float>(values[5]),
+                         static_cast<float>(values[6]), static_cast<float>(values[7]), static_cast<float>(values[8]));
+}
+
 ////////////////////////////////////////////////////////////
 void Light::generate(const std::vector<Segment>& segments)
 {
-    clear();
-    m_colors.clear();
+    generate(segments, getTransform().getValues());
+    swapBuffers();
+}
 
-    addVertex({0, 0});
-    m_colors.push_back(m_color);
+////////////////////////////////////////////////////////////
+void Light::generate(const std::vector<Segment>& segments, const double* transform)
+{
+    double aperture = getAperture();
 
-    double angle = 0, delta = 6.28318531f / static_cast<double>(m_complexity);
-        
-    for( size_t k(0); k < m_complexity; k++ )
+    m_nextFan.clear();
+    std::copy(transform, transform + 9, m_nextFanTransform);
+
+    // Inverse of the affine part of the transform
+
+    double determinant = transform[0] * transform[4] - transform[1] * transform[3];
+
+    if( determinant == 0 )
     {
-        addTriangle({std::cos(angle) * m_radius, std::sin(angle) * m_radius}, {std::cos(angle + delta) * m_radius, std::sin(angle + delta) * m_radius}, 0, segments);
-        angle+=delta;
+        m_isOutdated = false;
+        return;
     }
 
+    double a = transform[4] / determinant, b = -transform[1] / determinant,
+           c = -transform[3] / determinant, d = transform[0] / determinant;
+
+    auto toLocal = [&](const Point& p) { return Point(a * (p.x - transform[2]) + b * (p.y - transform[5]), c * (p.x - transform[2]) + d * (p.y - transform[5])); };
+
+    // The shader cuts the disc out per pixel, so the boundary
+    // polygon circumscribes the radius instead of lying inside it
+
+    double radius = m_radius, half = aperture / m_complexity / 2;
+
+    if( m_isShaded && half < 1 )
+        radius/=std::cos(half);
+
+    // Only the segments in the reach of the light are clipped
+
+    m_localSegments.clear();
+
+    for( auto& segment : segments )
+    {
+        Segment local(toLocal(segment.p1), toLocal(segment.p2));
+
+        if( isInReach(local) )
+            m_localSegments.push_back(local);
+    }
+
+    if( m_algorithm == Sweep )
+    {
+        m_polygon.clear();
+
+        m_visibility.compute(m_localSegments, radius, aperture, m_complexity, m_polygon);
+
+        for( size_t k(0); k + 1 < m_polygon.size(); k+=2 )
+            pushTriangle(m_polygon[k], m_polygon[k + 1]);
+    }
+
+    else
+    {
+        double angle = 0, delta = aperture / static_cast<double>(m_complexity);
+
+        m_localBuffer.clear();
+
+        for( auto& segment : m_localSegments )
+            m_localBuffer.push(segment);
+        
+        for( size_t k(0); k < m_complexity; k++ )
+        {
+            addTriangle({std::cos(angle) * radius, std::sin(angle) * radius}, {std::cos(angle + delta) * radius, std::sin(angle + delta) * radius}, 0, m_localSegments);
+            angle+=delta;
+        }
+    }
+
+    m_isOutdated = false;
+}
+
+////////////////////////////////////////////////////////////
+void Light::swapBuffers()
+{
+    std::swap(m_fan, m_nextFan);
+    std::swap(m_fanTransform, m_nextFanTransform);
+
+    m_needUpdate = true;
+}
+
+////////////////////////////////////////////////////////////
+void Light::setRenderTransform(const double* transform)
+{
+    std::copy(transform, transform + 9, m_fanTransform);
+
     m_needUpdate = true;
 }
 
@@ -168,9 +487,23 @@ void Light::addTriangle(Point p1, Point p2, Uint32 begin, const std::vector<Segm
     if( p1 == p2 )
         return;
 
+    // The triangle only shrinks below, the segments beyond it at
+    // this point never touch it
+
+    size_t base = m_culled.size();
+
+    if( begin < segments.size() )
+    {
+        m_culled.resize(base + segments.size() - begin);
+        m_localBuffer.cull(Point(), p1, p2, begin, &m_culled[base]);
+    }
+
     for( size_t k(begin); k < segments.size(); k++ )
     {
-        Segment s = convertToLocal(segments[k]);
+        if( m_culled[base + k - begin] )
+            continue;
+
+        const Segment& s = segments[k];
         double a = Vector2d::angle(s.p1, s.p2);
 
         if( a == 0 )
@@ -237,34 +570,46 @@ void Light::addTriangle(Point p1, Point p2, Uint32 begin, const std::vector<Segm
         }
     }
 
-    m_colors.push_back({m_color.r, m_color.g, m_color.b, char(255*(m_radius - p2.length()) / m_radius)});
-    m_colors.push_back({m_color.r, m_color.g, m_color.b, char(255*(m_radius - p1.length()) / m_radius)});
+    m_culled.resize(base);
 
-    addFace(getVertex(0), addVertex(p1), addVertex(p2));
+    pushTriangle(p1, p2);
 }
 
 ////////////////////////////////////////////////////////////
-void Light::draw(sf::RenderTarget& target, sf::RenderStates states) const
+void Light::pushTriangle(const Point& p1, const Point& p2)
 {
-    double* values = getTransform().getValues();
+    m_nextFan.push_back(sf::Vector2f(p1.x, p1.y));
+    m_nextFan.push_back(sf::Vector2f(p2.x, p2.y));
+}
 
+////////////////////////////////////////////////////////////
+void Light::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
     sf::Transform defaultTransform = states.transform;
 
-    states.transform = sf::Transform(static_cast<float>(values[0]), static_cast<float>(values[1]), static_cast<float>(values[2]),
-                                     static_cast<float>(values[3]), static_cast<float>(values[4]), static_cast<float>(values[5]),
-                                     static_cast<float>(values[6]), static_cast<float>(values[7]), static_cast<float>(values[8]));
+    states.transform = getRenderTransform();
 
     update();
 
-    for( auto& vertexArray : m_vertexArray )
-        target.draw(vertexArray, states);
+    if( m_isShaded )
+    {
+        sf::Shader* shader = ShaderLibrary::getFalloff();
+
+        shader->setParameter("curve", static_cast<float>(m_falloff));
+        states.shader = shader;
+    }
+
+    target.draw(m_vertexArray, states);
 
     if( m_debugMode )
     {
+        states.shader = nullptr;
+
+        target.draw(m_vertexArrayWireframe, states);
+
         states.transform = defaultTransform;
 
-        for( auto& vertexArray : m_vertexArrayDebug )
-            target.draw(vertexArray, states);
+        target.draw(m_vertexArrayDebug, states);
     }
 }
 
@@ -23,51 +23,189 @@
 ////////////////////////////////////////////////////////////
 
 #include <Zoom/LightManager.hpp>
+#include <Zoom/ShaderLibrary.hpp>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cmath>
 
 namespace zin
 {
 
+////////////////////////////////////////////////////////////
+// Margin baked around the view on every side, as a fraction of
+// its size, so that a moving camera does not bake every frame
+////////////////////////////////////////////////////////////
+static const double BakedMargin = .25;
+
+////////////////////////////////////////////////////////////
+// Get the distance from a point to a segment
+////////////////////////////////////////////////////////////
+static double getDistance(const Point& p, const Point& a, const Point& b)
+{
+    double dx = b.x - a.x, dy = b.y - a.y, length = dx * dx + dy * dy;
+    double t = length > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / length : 0;
+
+    t = std::max(0., std::min(1., t));
+
+    return Point(p.x - a.x - dx * t, p.y - a.y - dy * t).length();
+}
+
 ////////////////////////////////////////////////////////////	
 LightManager::LightManager(Uint32 width, Uint32 height, const Color& ambiantLightColor) :
+m_debugMode(false),
+m_needRebuild(false),
+m_needRedraw(true),
+m_needBake(false),
+m_hasView(false),
+m_isBatchingEnabled(true),
+m_isAsync(false),
+m_mode(Geometry),
+m_shadowMapResolution(512),
+m_tolerance(0),
+m_width(width),
+m_height(height),
+m_resolutionScale(1),
+m_updateBudget(0),
+m_clusterThreshold(0),
+m_clusterLevel(0),
 m_ambiantLightColor(sf::Color(ambiantLightColor.r, ambiantLightColor.g, ambiantLightColor.b, ambiantLightColor.a)),
-m_debugMode(false)
+m_view(sf::FloatRect(0, 0, width, height)),
+m_workers(1),
+m_batch(sf::Triangles),
+m_shadows(sf::Quads),
+m_occluderLines(sf::Lines)
 {
-    m_renderTexture.create(width, height);
+    create(m_renderTexture);
     m_renderTexture.clear(m_ambiantLightColor);
 }
 
 ////////////////////////////////////////////////////////////
-void LightManager::attach(Light& light)
+LightManager::~LightManager()
+{
+    finish();
+    stopThreads();
+
+    for( auto& occluder : m_occluders )
+        const_cast<Geom&>(occluder->geom).removeObserver(*occluder);
+}
+
+////////////////////////////////////////////////////////////
+LightManager::LightHandle LightManager::attach(Light& light, bool isStatic)
 {
-	m_lights.push_back(&light);
+    auto it = m_lightHandles.find(&light);
+
+    if( it != m_lightHandles.end() )
+        return it->second;
+
+    LightInfo info;
+    info.light = &light;
+    info.dirty = true;
+    info.isStatic = isStatic;
+    info.isAggregate = false;
+    info.isClustered = false;
+    info.isMerged = false;
+    info.hasDisc = false;
+    info.staleness = 0;
+    info.priority = 0;
+
+    double* values = light.getTransform().getValues();
+    std::copy(values, values + 9, info.transform);
+
+    LightHandle handle = m_lights.insert(info);
+    m_lights.get(handle)->handle = handle;
+    m_lightHandles[&light] = handle;
+
+    return handle;
 }
 
 ////////////////////////////////////////////////////////////
 void LightManager::detach(Light& light)
 {
-    for( auto it = m_lights.begin(); it != m_lights.end(); ++it )
-        if( &light == *it )
-        {
-            m_lights.erase(it);
-            break;
-        }
+    auto it = m_lightHandles.find(&light);
+
+    if( it != m_lightHandles.end() )
+        detach(it->second);
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::detach(LightHandle handle)
+{
+    // A task still running for the light is dropped by the next
+    // finish, the handle no longer resolves
+
+    LightInfo* info = m_lights.get(handle);
+
+    if( !info )
+        return;
+
+    (info->isStatic ? m_needBake : m_needRedraw) = true;
+
+    m_lightHandles.erase(info->light);
+    m_lights.remove(handle);
 }
 
 ////////////////////////////////////////////////////////////
-void LightManager::attach(const Geom& geom)
+LightManager::GeomHandle LightManager::attach(const Geom& geom, bool isStatic)
 {
-    m_geoms.push_back(&geom);
+    auto it = m_geomHandles.find(&geom);
+
+    if( it != m_geomHandles.end() )
+        return it->second;
+
+    // The grids are changed in place, the threads must be done with them
+
+    finish();
+
+    Occluder* occluder = new Occluder(geom, isStatic);
+
+    GeomHandle handle = m_occluders.insert(std::unique_ptr<Occluder>(occluder));
+    m_geomHandles[&geom] = handle;
+
+    occluder->load(m_tolerance);
+    const_cast<Geom&>(geom).addObserver(*occluder);
+    invalidate(*occluder);
+
+    m_occlusion.insert(*occluder);
+
+    if( isStatic )
+        m_staticOcclusion.insert(*occluder);
+
+    (isStatic ? m_needBake : m_needRedraw) = true;
+
+    return handle;
 }
 
 ////////////////////////////////////////////////////////////
 void LightManager::detach(const Geom& geom) 
 {
-    for( auto it = m_geoms.begin(); it != m_geoms.end(); ++it )
-        if( &geom == *it )
-        {
-            m_geoms.erase(it);
-            break;
-        }
+    auto it = m_geomHandles.find(&geom);
+
+    if( it != m_geomHandles.end() )
+        detach(it->second);
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::detach(GeomHandle handle)
+{
+    std::unique_ptr<Occluder>* occluder = m_occluders.get(handle);
+
+    if( !occluder )
+        return;
+
+    const Geom& geom = (*occluder)->geom;
+
+    finish();
+
+    invalidate(**occluder);
+    m_occlusion.remove(**occluder);
+    m_staticOcclusion.remove(**occluder);
+
+    ((*occluder)->isStatic ? m_needBake : m_needRedraw) = true;
+
+    const_cast<Geom&>(geom).removeObserver(**occluder);
+    m_geomHandles.erase(&geom);
+    m_occluders.remove(handle);
 }
 
 ////////////////////////////////////////////////////////////
@@ -76,33 +214,416 @@ void LightManager::setBlendMode(sf::BlendMode blendMode)
     m_blendMode = blendMode;
 }
 
+////////////////////////////////////////////////////////////
+void LightManager::setGridCellSize(double cellSize)
+{
+    finish();
+
+    if( !(cellSize > 0) )
+        return;
+
+    m_occlusion.grid.setCellSize(cellSize);
+    m_staticOcclusion.grid.setCellSize(cellSize);
+    m_needRebuild = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setSimplification(double tolerance)
+{
+    m_tolerance = tolerance;
+
+    for( auto& occluder : m_occluders )
+        occluder->changed = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setThreadsCount(Uint32 count)
+{
+    finish();
+
+    if( count == 0 )
+        count = std::max(1u, std::thread::hardware_concurrency());
+
+    // The threads are kept from an update to the next one
+
+    stopThreads();
+    m_workers.resize(count);
+    startThreads();
+}
+
+////////////////////////////////////////////////////////////
+Uint32 LightManager::getThreadsCount() const
+{
+    return m_workers.size();
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setUpdateBudget(Uint32 microseconds)
+{
+    finish();
+
+    m_updateBudget = microseconds;
+}
+
+////////////////////////////////////////////////////////////
+Uint32 LightManager::getUpdateBudget() const
+{
+    return m_updateBudget;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::enableAsyncGeneration(bool enabled)
+{
+    finish();
+
+    if( m_isAsync == enabled )
+        return;
+
+    // Asynchronously, the first worker needs its own thread as well
+
+    stopThreads();
+    m_isAsync = enabled;
+    startThreads();
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setClusterThreshold(double threshold)
+{
+    finish();
+
+    m_clusterThreshold = std::max(0., threshold);
+
+    if( m_clusterThreshold == 0 )
+        clearClusters();
+}
+
+////////////////////////////////////////////////////////////
+double LightManager::getClusterThreshold() const
+{
+    return m_clusterThreshold;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::enableBatching(bool enabled)
+{
+    m_isBatchingEnabled = enabled;
+    m_needRedraw = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setMode(Mode mode)
+{
+    finish();
+
+    if( mode == m_mode || (mode == ShadowVolume && !ShaderLibrary::getShadowVolume()) )
+        return;
+
+    if( mode == PolarShadowMap && (!ShaderLibrary::getPolarMap() || !ShaderLibrary::getPolarShading()) )
+        return;
+
+    for( auto& info : m_lights )
+    {
+        info.dirty = true;
+        info.hasDisc = false;
+    }
+
+    m_mode = mode;
+    m_needRebuild = true;
+    m_needBake = true;
+}
+
+////////////////////////////////////////////////////////////
+LightManager::Mode LightManager::getMode() const
+{
+    return m_mode;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setShadowMapResolution(Uint32 resolution)
+{
+    m_shadowMapResolution = resolution;
+
+    m_needBake = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setView(const sf::View& view)
+{
+    // An unchanged view keeps the lightmap, and the static lights are
+    // baked again only once the view leaves the area they were baked over
+
+    if( m_hasView && view.getCenter() == m_view.getCenter() && view.getSize() == m_view.getSize() && view.getRotation() == m_view.getRotation() )
+        return;
+
+    m_view = view;
+    m_hasView = true;
+
+    m_renderTexture.setView(m_view);
+    m_needRedraw = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::resetView()
+{
+    if( !m_hasView )
+        return;
+
+    m_hasView = false;
+    m_view = sf::View(sf::FloatRect(0, 0, m_width, m_height));
+
+    m_renderTexture.setView(m_view);
+    m_needRedraw = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::setResolutionScale(double scale)
+{
+    m_resolutionScale = std::max(.01, std::min(1., scale));
+
+    create(m_renderTexture);
+
+    m_needBake = true;
+}
+
+////////////////////////////////////////////////////////////
+double LightManager::getResolutionScale() const
+{
+    return m_resolutionScale;
+}
+
 ////////////////////////////////////////////////////////////
 void LightManager::update()
 {
-    std::vector<Segment> segments;
+    // The job started by the previous update is collected first
 
-    for( auto& geom : m_geoms )
-        for( size_t k(0); k < geom->getLiaisonsCount(); k++ )
-            segments.push_back(geom->getLiaison(k).getSegment());
+    finish();
 
-	for( auto& light : m_lights )
-        light->generate(segments);
+    for( auto& occluder : m_occluders )
+        if( occluder->changed || occluder->moved )
+        {
+            // The lights reaching the old or the new position are affected,
+            // and only the segments of the occluder are replaced in the grids
 
-    m_renderTexture.clear(m_ambiantLightColor);
+            invalidate(*occluder);
+            m_occlusion.remove(*occluder);
+            m_staticOcclusion.remove(*occluder);
+
+            occluder->load(m_tolerance);
+
+            invalidate(*occluder);
+            m_occlusion.insert(*occluder);
+
+            if( occluder->isStatic )
+                m_staticOcclusion.insert(*occluder);
+
+            (occluder->isStatic ? m_needBake : m_needRedraw) = true;
+        }
+
+    // The removed segments keep their indices, the grids are packed
+    // again once they make half of them
+
+    for( auto occlusion : {&m_occlusion, &m_staticOcclusion} )
+        if( occlusion->grid.getRemovedCount() * 2 > occlusion->grid.getSegments().size() )
+            m_needRebuild = true;
+
+    if( m_needRebuild )
+    {
+        m_occlusion.clear();
+        m_staticOcclusion.clear();
+
+        for( auto& occluder : m_occluders )
+        {
+            m_occlusion.insert(*occluder);
+
+            if( occluder->isStatic )
+                m_staticOcclusion.insert(*occluder);
+        }
+
+        m_needRebuild = false;
+        m_needRedraw = true;
+    }
+
+    // A camera moving within the baked margin keeps the baked texture
+
+    if( !isInBakedArea() )
+    {
+        m_bakedView = m_view;
+
+        if( m_hasView )
+            m_bakedView.setSize(m_view.getSize() * static_cast<float>(1 + 2 * BakedMargin));
+
+        m_needBake = true;
+    }
+
+    // The lights out of the view keep their dirty flag until they enter it
+
+    Point min, max, staticMin, staticMax;
+    getVisibleArea(m_view, min, max);
+    getVisibleArea(m_bakedView, staticMin, staticMax);
+
+    if( m_clusterThreshold > 0 )
+        cluster(m_width / m_view.getSize().x);
+
+    double reach = 0, staticReach = 0, scale = m_renderTexture.getSize().x / m_view.getSize().x;
+    m_visible.clear();
+    m_staticVisible.clear();
+
+	for( auto& info : m_lights )
+    {
+        double* values = info.light->getTransform().getValues();
+
+        if( !std::equal(values, values + 9, info.transform) )
+        {
+            std::copy(values, values + 9, info.transform);
+            info.dirty = true;
+            (info.isStatic ? m_needBake : m_needRedraw) = true;
+        }
+
+        // A merged light is drawn by its cluster
+
+        if( info.isMerged )
+            continue;
+
+        Point center = info.light->getGlobalCenter();
+        double radius = info.light->getGlobalRadius();
+
+        const Point& low = info.isStatic ? staticMin : min;
+        const Point& high = info.isStatic ? staticMax : max;
+
+        if( m_hasView && (center.x + radius < low.x || center.x - radius > high.x || center.y + radius < low.y || center.y - radius > high.y) )
+            continue;
+
+        (info.isStatic ? m_staticVisible : m_visible).push_back(info.light);
+        double& lightsReach = info.isStatic ? staticReach : reach;
+        lightsReach = std::max(lightsReach, radius);
+
+        info.light->adaptComplexity(scale);
+
+        // The GPU modes shadow the full disc of the light, which is
+        // only generated again when the light itself changes
+
+        if( m_mode != Geometry && info.hasDisc && !info.light->isOutdated() )
+        {
+            // Its shadows change all the same, so it is drawn again
+
+            if( info.dirty )
+            {
+                info.light->setRenderTransform(info.transform);
+                (info.isStatic ? m_needBake : m_needRedraw) = true;
+            }
+
+            info.dirty = false;
+        }
+
+        // The flag is cleared once the light is generated
+
+        else if( info.dirty || info.light->isOutdated() )
+        {
+            m_pending.push_back(&info);
+            info.dirty = true;
+        }
+    }
 
-    for( auto& light : m_lights )
-        m_renderTexture.draw(*light);
+    if( !m_pending.empty() )
+    {
+        // With a budget, the lights near the center of the view come
+        // first, and the longer a light waits the nearer it counts
 
-    m_renderTexture.display();
+        if( m_updateBudget > 0 )
+        {
+            const sf::Vector2f& focus = m_view.getCenter();
+
+            for( auto info : m_pending )
+            {
+                Point center = info->light->getGlobalCenter();
+                info->priority = Point(center.x - focus.x, center.y - focus.y).length() / (1 + info->staleness);
+            }
+
+            std::sort(m_pending.begin(), m_pending.end(), [](const LightInfo* a, const LightInfo* b) { return a->priority < b->priority; });
+        }
+
+        // The tasks hold a copy of the transforms, the geoms are
+        // already copied into the grids
+
+        for( auto info : m_pending )
+        {
+            Task task;
+            task.handle = info->handle;
+            task.light = info->light;
+            std::copy(info->transform, info->transform + 9, task.transform);
+            task.isStatic = info->isStatic;
+            task.done = false;
+
+            m_tasks.push_back(task);
+        }
+
+        m_pending.clear();
+
+        generatePending();
+
+        if( !m_isAsync )
+            finish();
+    }
+
+    min = Point(min.x - reach, min.y - reach);
+    max = Point(max.x + reach, max.y + reach);
+
+    if( m_needBake )
+    {
+        if( !m_staticVisible.empty() )
+        {
+            create(m_bakedTexture, m_hasView ? 1 + 2 * BakedMargin : 1);
+            m_bakedTexture.setView(m_bakedView);
+
+            staticMin = Point(staticMin.x - staticReach, staticMin.y - staticReach);
+            staticMax = Point(staticMax.x + staticReach, staticMax.y + staticReach);
+
+            m_bakedTexture.clear(m_ambiantLightColor);
+            drawLights(m_bakedTexture, m_staticVisible, m_staticOcclusion.grid, staticMin, staticMax);
+            m_bakedTexture.display();
+        }
+
+        m_needBake = false;
+        m_needRedraw = true;
+    }
+
+    if( m_needRedraw )
+    {
+        // The baked static lights replace the ambiant light
+
+        if( m_staticVisible.empty() )
+            m_renderTexture.clear(m_ambiantLightColor);
+
+        else
+        {
+            // The baked area is laid back over the world, the view falls within it
+
+            sf::Sprite sprite(m_bakedTexture.getTexture());
+            sf::Vector2f size(m_bakedTexture.getSize());
+
+            sprite.setOrigin(size.x / 2, size.y / 2);
+            sprite.setScale(m_bakedView.getSize().x / size.x, m_bakedView.getSize().y / size.y);
+            sprite.setRotation(m_bakedView.getRotation());
+            sprite.setPosition(m_bakedView.getCenter());
+
+            m_renderTexture.draw(sprite, sf::BlendNone);
+        }
+
+        drawLights(m_renderTexture, m_visible, m_occlusion.grid, min, max);
+
+        m_renderTexture.display();
+        m_needRedraw = false;
+    }
 }
 
 ////////////////////////////////////////////////////////////
 void LightManager::setDebugMode(bool enabled)
 {
-    for( auto& light : m_lights )
-        light->setDebugMode(enabled);
+    for( auto& info : m_lights )
+        info.light->setDebugMode(enabled);
 
     m_debugMode = enabled;
+    m_needBake = true;
 }
 
 ////////////////////////////////////////////////////////////
@@ -116,7 +637,1131 @@ void LightManager::draw(sf::RenderTarget& target, sf::RenderStates states) const
 {
     sf::Sprite sprite;
     sprite.setTexture(m_renderTexture.getTexture());
-    target.draw(sprite, states);
+
+    // A reduced lightmap is stretched back, smoothed by the texture filtering
+
+    sprite.setScale(static_cast<float>(m_width) / m_renderTexture.getSize().x, static_cast<float>(m_height) / m_renderTexture.getSize().y);
+
+    // With a view, the lights are already seen from the camera
+
+    if( m_hasView )
+    {
+        sf::View view = target.getView();
+
+        target.setView(target.getDefaultView());
+        target.draw(sprite, states);
+        target.setView(view);
+    }
+
+    else
+        target.draw(sprite, states);
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::create(sf::RenderTexture& texture, double scale)
+{
+    sf::Vector2u size(std::max(1., std::ceil(m_width * m_resolutionScale * scale)), std::max(1., std::ceil(m_height * m_resolutionScale * scale)));
+
+    if( texture.getSize() != size )
+        texture.create(size.x, size.y);
+
+    texture.setSmooth(m_resolutionScale < 1);
+    texture.setView(m_view);
+}
+
+////////////////////////////////////////////////////////////
+bool LightManager::isInBakedArea() const
+{
+    if( m_bakedView.getRotation() != m_view.getRotation() )
+        return false;
+
+    if( !m_hasView )
+        return m_bakedView.getSize() == m_view.getSize() && m_bakedView.getCenter() == m_view.getCenter();
+
+    if( m_bakedView.getSize() != m_view.getSize() * static_cast<float>(1 + 2 * BakedMargin) )
+        return false;
+
+    // The offset of the view is measured along the axes of the baked area
+
+    sf::Vector2f offset = m_view.getCenter() - m_bakedView.getCenter();
+    double angle = m_view.getRotation() * 3.14159265 / 180,
+           x = offset.x * std::cos(angle) + offset.y * std::sin(angle),
+           y = offset.y * std::cos(angle) - offset.x * std::sin(angle);
+
+    return std::abs(x) <= m_view.getSize().x * BakedMargin && std::abs(y) <= m_view.getSize().y * BakedMargin;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::getVisibleArea(const sf::View& view, Point& min, Point& max) const
+{
+    if( !m_hasView )
+    {
+        min = max = Point(0, 0);
+        return;
+    }
+
+    const sf::Vector2f& center = view.getCenter();
+    const sf::Vector2f& size = view.getSize();
+
+    double angle = view.getRotation() * 3.14159265 / 180,
+           width = std::abs(size.x / 2 * std::cos(angle)) + std::abs(size.y / 2 * std::sin(angle)),
+           height = std::abs(size.x / 2 * std::sin(angle)) + std::abs(size.y / 2 * std::cos(angle));
+
+    min = Point(center.x - width, center.y - height);
+    max = Point(center.x + width, center.y + height);
 }
 
-}
\ No newline at end of file
+////////////////////////////////////////////////////////////
+void LightManager::cluster(double scale)
+{
+    // The cells are anchored to the world and their size only
+    // changes by powers of two, with some margin, so that the
+    // clusters stay the same while the view moves or zooms a bit
+
+    double level = std::log2(m_clusterThreshold / scale);
+
+    if( level > m_clusterLevel + .25 || level < m_clusterLevel - 1.25 )
+    {
+        clearClusters();
+        m_clusterLevel = std::ceil(level);
+    }
+
+    double cellSize = std::pow(2., m_clusterLevel);
+
+    for( auto& info : m_lights )
+    {
+        if( info.isStatic || info.isAggregate )
+            continue;
+
+        // A light is merged under the threshold, and only split
+        // back a bit above it
+
+        double radius = info.light->getGlobalRadius() * scale;
+        info.isClustered = radius > 0 && radius < m_clusterThreshold * (info.isClustered ? 1.25 : 1);
+
+        if( !info.isClustered )
+        {
+            if( info.isMerged )
+            {
+                info.isMerged = false;
+                m_needRedraw = true;
+            }
+
+            continue;
+        }
+
+        Point center = info.light->getGlobalCenter();
+        Uint32 x = static_cast<Uint32>(static_cast<Int32>(std::floor(center.x / cellSize))),
+               y = static_cast<Uint32>(static_cast<Int32>(std::floor(center.y / cellSize)));
+
+        m_clusters[(static_cast<Uint64>(x) << 32) | y].members.push_back(&info);
+    }
+
+    // The merged light keeps the weighted center and color of its
+    // members, covers all of them, and spreads their intensity
+    // over its disc
+
+    for( auto& pair : m_clusters )
+    {
+        Cluster& cluster = pair.second;
+        bool isMerged = cluster.members.size() > 1;
+
+        for( auto member : cluster.members )
+            if( member->isMerged != isMerged )
+            {
+                member->isMerged = isMerged;
+                m_needRedraw = true;
+            }
+
+        if( !isMerged )
+        {
+            cluster.members.clear();
+            continue;
+        }
+
+        double weight = 0, x = 0, y = 0, r = 0, g = 0, b = 0;
+
+        for( auto member : cluster.members )
+        {
+            const Color& color = member->light->getColor();
+            Point center = member->light->getGlobalCenter();
+            double radius = member->light->getGlobalRadius(),
+                   w = std::max<double>(color.a, 1) * radius * radius;
+
+            weight += w;
+            x += center.x * w;
+            y += center.y * w;
+            r += color.r * w;
+            g += color.g * w;
+            b += color.b * w;
+        }
+
+        Point center(x / weight, y / weight);
+        double radius = 0;
+
+        for( auto member : cluster.members )
+        {
+            Point c = member->light->getGlobalCenter();
+            radius = std::max(radius, Point(c.x - center.x, c.y - center.y).length() + member->light->getGlobalRadius());
+        }
+
+        if( !cluster.light )
+        {
+            cluster.light.reset(new Light(radius));
+            cluster.light->enableAdaptiveComplexity();
+        }
+
+        double alpha = std::min(255., weight / (radius * radius));
+
+        cluster.light->setPosition(center);
+        cluster.light->setRadius(radius);
+        cluster.light->setColor(Color(static_cast<Uint8>(r / weight + .5), static_cast<Uint8>(g / weight + .5), static_cast<Uint8>(b / weight + .5), static_cast<Uint8>(alpha + .5)));
+    }
+
+    // The lights are only attached and detached now, the members
+    // pointing into them
+
+    for( auto it = m_clusters.begin(); it != m_clusters.end(); )
+    {
+        Cluster& cluster = it->second;
+
+        if( cluster.members.empty() )
+        {
+            if( cluster.handle.isValid() )
+                detach(cluster.handle);
+
+            it = m_clusters.erase(it);
+            continue;
+        }
+
+        if( !cluster.handle.isValid() )
+        {
+            cluster.handle = attach(*cluster.light);
+            m_lights.get(cluster.handle)->isAggregate = true;
+        }
+
+        cluster.members.clear();
+        ++it;
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::clearClusters()
+{
+    for( auto& pair : m_clusters )
+        if( pair.second.handle.isValid() )
+            detach(pair.second.handle);
+
+    m_clusters.clear();
+
+    for( auto& info : m_lights )
+        info.isMerged = false;
+
+    m_needRedraw = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::drawLights(sf::RenderTexture& target, const std::vector<Light*>& lights, const SegmentGrid& grid, const Point& min, const Point& max)
+{
+    // The debug overlays are drawn by the lights themselves
+
+    if( m_mode == ShadowVolume )
+        drawShadowVolumes(target, lights, grid);
+
+    else if( m_mode == PolarShadowMap )
+    {
+        buildOccluders(grid, min, max);
+        drawPolarShadowMaps(target, lights);
+    }
+
+    else if( m_isBatchingEnabled && !m_debugMode )
+    {
+        sf::Shader* shader = ShaderLibrary::getFalloff();
+
+        // One batch per attenuation curve, the shader sets it for the whole draw
+
+        for( int falloff = Light::Linear; falloff <= Light::Smoothstep; falloff++ )
+        {
+            m_batch.clear();
+
+            for( auto light : lights )
+                if( light->getFalloff() == falloff || !shader )
+                    light->appendTo(m_batch);
+
+            if( m_batch.getVertexCount() == 0 )
+                continue;
+
+            if( shader )
+                shader->setParameter("curve", static_cast<float>(falloff));
+
+            target.draw(m_batch, shader);
+
+            if( !shader )
+                break;
+        }
+    }
+
+    else
+        for( auto light : lights )
+            target.draw(*light);
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::buildOccluders(const SegmentGrid& grid, const Point& min, const Point& max)
+{
+    m_occluderLines.clear();
+
+    if( m_hasView )
+        grid.query(min, max, m_workers[0].indices);
+
+    else
+    {
+        m_workers[0].indices.clear();
+
+        for( size_t k(0); k < grid.getSegments().size(); k++ )
+            if( !grid.isRemoved(k) )
+                m_workers[0].indices.push_back(k);
+    }
+
+    for( auto indice : m_workers[0].indices )
+    {
+        const Segment& segment = grid.getSegment(indice);
+
+        m_occluderLines.append(sf::Vertex(sf::Vector2f(segment.p1.x, segment.p1.y), sf::Color::White));
+        m_occluderLines.append(sf::Vertex(sf::Vector2f(segment.p2.x, segment.p2.y), sf::Color::White));
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::invalidate(const Occluder& occluder)
+{
+    if( occluder.segments.empty() )
+        return;
+
+    // The static lights only see the static occluders
+
+    for( auto& info : m_lights )
+    {
+        if( info.isStatic && !occluder.isStatic )
+            continue;
+
+        Point center = info.light->getGlobalCenter();
+        double radius = info.light->getGlobalRadius();
+
+        double x = std::max(occluder.min.x, std::min(center.x, occluder.max.x)) - center.x,
+               y = std::max(occluder.min.y, std::min(center.y, occluder.max.y)) - center.y;
+
+        if( x * x + y * y <= radius * radius )
+            info.dirty = true;
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::generate(const Task& task, const Occlusion& occlusion, Worker& worker) const
+{
+    Light& light = *task.light;
+    const double* t = task.transform;
+
+    worker.segments.clear();
+
+    // Without occluders, the light is its full disc
+
+    if( m_mode != Geometry )
+    {
+        light.generate(worker.segments, t);
+
+        return;
+    }
+
+    // The light may move meanwhile, only its copied transform is used
+
+    Point center(t[2], t[5]);
+    double radius = light.getRadius() * std::max(Point(t[0], t[3]).length(), Point(t[1], t[4]).length());
+
+    occlusion.grid.query(center, radius, worker.indices);
+
+    // The sides are only reset for the loops met by the light
+
+    if( worker.sides.size() < occlusion.ranges.size() / 2 )
+        worker.sides.resize(occlusion.ranges.size() / 2, 0);
+
+    for( auto indice : worker.indices )
+    {
+        const Segment& segment = occlusion.grid.getSegment(indice);
+
+        if( getDistance(center, segment.p1, segment.p2) > radius )
+            continue;
+
+        // A closed loop hides its own sides facing away from the
+        // light, the inner ones from outside and the outer ones
+        // from inside
+
+        Int32 loop = occlusion.loops[indice];
+
+        if( loop >= 0 )
+        {
+            char& side = worker.sides[loop];
+
+            if( side == 0 )
+            {
+                side = occlusion.contains(loop, center) ? 1 : -1;
+                worker.loops.push_back(loop);
+            }
+
+            double cross = (segment.p2.x - segment.p1.x) * (center.y - segment.p1.y) - (segment.p2.y - segment.p1.y) * (center.x - segment.p1.x);
+
+            if( cross * side <= 0 )
+                continue;
+        }
+
+        worker.segments.push_back(segment);
+    }
+
+    for( auto loop : worker.loops )
+        worker.sides[loop] = 0;
+
+    worker.loops.clear();
+
+    light.generate(worker.segments, t);
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::generatePending()
+{
+    m_next = 0;
+    m_deadline = Clock::now() + std::chrono::microseconds(m_updateBudget);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_busy = m_threads.size();
+        m_round++;
+    }
+
+    m_wakeUp.notify_all();
+
+    // The calling thread takes its share, the drawing stays on it
+
+    if( !m_isAsync )
+        work(m_workers[0]);
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::work(Worker& worker)
+{
+    for( size_t k(m_next++); k < m_tasks.size(); k = m_next++ )
+    {
+        // Past the budget, the remaining lights wait for the next frames,
+        // but at least one light is generated every frame
+
+        if( m_updateBudget > 0 && k > 0 && Clock::now() > m_deadline )
+            break;
+
+        Task& task = m_tasks[k];
+
+        generate(task, task.isStatic ? m_staticOcclusion : m_occlusion, worker);
+        task.done = true;
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::startThreads()
+{
+    m_isStopping = false;
+
+    for( size_t k(m_isAsync ? 0 : 1); k < m_workers.size(); k++ )
+        m_threads.push_back(std::thread(&LightManager::run, this, std::ref(m_workers[k]), m_round));
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::stopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_isStopping = true;
+    }
+
+    m_wakeUp.notify_all();
+
+    for( auto& thread : m_threads )
+        thread.join();
+
+    m_threads.clear();
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::run(Worker& worker, Uint32 round)
+{
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_wakeUp.wait(lock, [&] { return m_isStopping || m_round != round; });
+
+            if( m_isStopping )
+                return;
+
+            round = m_round;
+        }
+
+        work(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if( --m_busy == 0 )
+                m_done.notify_all();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::finish()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_done.wait(lock, [this] { return m_busy == 0; });
+    }
+
+    // The lights left over keep their previous polygon
+
+    for( auto& task : m_tasks )
+    {
+        LightInfo* info = m_lights.get(task.handle);
+
+        if( !info )
+            continue;
+
+        if( task.done )
+        {
+            task.light->swapBuffers();
+
+            info->dirty = false;
+            info->hasDisc = m_mode != Geometry;
+            info->staleness = 0;
+            (info->isStatic ? m_needBake : m_needRedraw) = true;
+        }
+
+        else
+            info->staleness++;
+    }
+
+    m_tasks.clear();
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::drawShadowVolumes(sf::RenderTarget& target, const std::vector<Light*>& lights, const SegmentGrid& grid)
+{
+    sf::Shader* shader = ShaderLibrary::getShadowVolume();
+
+    sf::RenderStates shadowStates(sf::BlendNone);
+    shadowStates.shader = shader;
+
+    // The light texture grows to the largest target, the baked one included
+
+    sf::Vector2u textureSize = m_lightTexture.getSize();
+
+    if( textureSize.x < target.getSize().x || textureSize.y < target.getSize().y )
+    {
+        m_lightTexture.create(std::max(textureSize.x, target.getSize().x), std::max(textureSize.y, target.getSize().y));
+        m_lightTexture.setSmooth(m_resolutionScale < 1);
+    }
+
+    sf::RenderStates copyStates(sf::BlendAlpha);
+    copyStates.texture = &m_lightTexture.getTexture();
+
+    // The light texture is seen from the same view as the target, pixel for pixel
+
+    sf::View view = target.getView();
+    sf::Vector2f size(target.getSize());
+
+    view.setViewport(sf::FloatRect(0, 0, size.x / m_lightTexture.getSize().x, size.y / m_lightTexture.getSize().y));
+    m_lightTexture.setView(view);
+
+    const sf::Transform& transform = view.getTransform();
+
+    sf::VertexArray bounds(sf::Quads, 4);
+
+    for( auto light : lights )
+    {
+        Point center = light->getGlobalCenter();
+        double radius = light->getGlobalRadius();
+
+        // Only the square around the light is cleared and copied, not the whole texture
+
+        for( size_t i = 0; i < 4; i++ )
+        {
+            sf::Vector2f corner(center.x + (i == 1 || i == 2 ? radius : -radius), center.y + (i >= 2 ? radius : -radius));
+            sf::Vector2f coords = transform.transformPoint(corner);
+
+            bounds[i].position = corner;
+            bounds[i].texCoords = sf::Vector2f((coords.x + 1) * size.x / 2, (1 - coords.y) * size.y / 2);
+            bounds[i].color = sf::Color::Transparent;
+        }
+
+        // Each occluder the light reaches becomes a quad whose far
+        // side is extruded by the shader
+
+        m_shadows.clear();
+        grid.query(center, radius, m_workers[0].indices);
+
+        for( auto indice : m_workers[0].indices )
+        {
+            const Segment& segment = grid.getSegment(indice);
+
+            if( getDistance(center, segment.p1, segment.p2) > radius )
+                continue;
+
+            sf::Vector2f p1(segment.p1.x, segment.p1.y), p2(segment.p2.x, segment.p2.y);
+
+            m_shadows.append(sf::Vertex(p1, sf::Color::Transparent, sf::Vector2f(0, 0)));
+            m_shadows.append(sf::Vertex(p2, sf::Color::Transparent, sf::Vector2f(0, 0)));
+            m_shadows.append(sf::Vertex(p2, sf::Color::Transparent, sf::Vector2f(1, 0)));
+            m_shadows.append(sf::Vertex(p1, sf::Color::Transparent, sf::Vector2f(1, 0)));
+        }
+
+        shader->setParameter("light", center.x, center.y);
+
+        // The shadows overwrite the disc with transparent pixels
+
+        m_lightTexture.draw(bounds, sf::RenderStates(sf::BlendNone));
+        m_lightTexture.draw(*light, sf::RenderStates(sf::BlendNone));
+        m_lightTexture.draw(m_shadows, shadowStates);
+        m_lightTexture.display();
+
+        for( size_t i = 0; i < 4; i++ )
+            bounds[i].color = sf::Color::White;
+
+        target.draw(bounds, copyStates);
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::drawPolarShadowMaps(sf::RenderTarget& target, const std::vector<Light*>& lights)
+{
+    sf::Shader* polarMap = ShaderLibrary::getPolarMap();
+    sf::Shader* polarShading = ShaderLibrary::getPolarShading();
+
+    if( lights.empty() )
+        return;
+
+    // The atlas cannot be taller than a texture, the lights beyond
+    // its height are drawn in further chunks
+
+    size_t rows = std::min<size_t>(lights.size(), sf::Texture::getMaximumSize());
+
+    if( m_polarMap.getSize().x != m_shadowMapResolution || m_polarMap.getSize().y < rows )
+        m_polarMap.create(m_shadowMapResolution, rows);
+
+    float width = m_polarMap.getSize().x, height = m_polarMap.getSize().y;
+
+    // The occluders are drawn once for all the lights, over the box
+    // of their discs at the density of the target
+
+    Point min = lights[0]->getGlobalCenter(), max = min;
+
+    for( auto light : lights )
+    {
+        Point center = light->getGlobalCenter();
+        double radius = light->getGlobalRadius();
+
+        min.x = std::min(min.x, center.x - radius);
+        min.y = std::min(min.y, center.y - radius);
+        max.x = std::max(max.x, center.x + radius);
+        max.y = std::max(max.y, center.y + radius);
+    }
+
+    const sf::View& targetView = target.getView();
+    Uint32 maximum = sf::Texture::getMaximumSize();
+
+    sf::Vector2f density(target.getSize().x * targetView.getViewport().width / targetView.getSize().x,
+                         target.getSize().y * targetView.getViewport().height / targetView.getSize().y);
+
+    sf::Vector2u size(std::min<Uint32>(std::ceil((max.x - min.x) * density.x), maximum),
+                      std::min<Uint32>(std::ceil((max.y - min.y) * density.y), maximum));
+
+    size.x = std::max(size.x, 1u);
+    size.y = std::max(size.y, 1u);
+
+    // The texture only grows, the box fills its top left corner
+
+    sf::Vector2u textureSize = m_occlusionTexture.getSize();
+
+    if( textureSize.x < size.x || textureSize.y < size.y )
+    {
+        m_occlusionTexture.create(std::max(textureSize.x, size.x), std::max(textureSize.y, size.y));
+        m_occlusionTexture.setSmooth(true);
+    }
+
+    sf::Vector2f ratio(static_cast<float>(size.x) / m_occlusionTexture.getSize().x, static_cast<float>(size.y) / m_occlusionTexture.getSize().y);
+    sf::View view(sf::Vector2f((min.x + max.x) / 2, (min.y + max.y) / 2), sf::Vector2f(max.x - min.x, max.y - min.y));
+
+    view.setViewport(sf::FloatRect(0, 0, ratio.x, ratio.y));
+
+    m_occlusionTexture.setView(view);
+    m_occlusionTexture.clear(sf::Color::Transparent);
+    m_occlusionTexture.draw(m_occluderLines);
+    m_occlusionTexture.display();
+
+    sf::FloatRect area(min.x, min.y, (max.x - min.x) / ratio.x, (max.y - min.y) / ratio.y);
+
+    polarMap->setParameter("occluders", m_occlusionTexture.getTexture());
+    polarShading->setParameter("polarMap", m_polarMap.getTexture());
+
+    for( size_t first(0); first < lights.size(); first += rows )
+    {
+        size_t count = std::min(rows, lights.size() - first);
+
+        drawPolarShadowMaps(target, &lights[first], count, area, width, height);
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::drawPolarShadowMaps(sf::RenderTarget& target, Light* const* lights, size_t count, const sf::FloatRect& area, float width, float height)
+{
+    sf::Shader* polarMap = ShaderLibrary::getPolarMap();
+    sf::Shader* polarShading = ShaderLibrary::getPolarShading();
+
+    // First pass, one row of distances per light
+
+    m_polarMap.clear(sf::Color::White);
+
+    for( size_t k(0); k < count; k++ )
+    {
+        Point center = lights[k]->getGlobalCenter();
+        float radius = lights[k]->getGlobalRadius();
+
+        polarMap->setParameter("center", (center.x - area.left) / area.width, 1 - (center.y - area.top) / area.height);
+        polarMap->setParameter("radius", radius / area.width, radius / area.height);
+
+        sf::Vertex row[] = {sf::Vertex(sf::Vector2f(0,     k),     sf::Vector2f(0, 0)),
+                            sf::Vertex(sf::Vector2f(width, k),     sf::Vector2f(1, 0)),
+                            sf::Vertex(sf::Vector2f(width, k + 1), sf::Vector2f(1, 0)),
+                            sf::Vertex(sf::Vector2f(0,     k + 1), sf::Vector2f(0, 0))};
+
+        m_polarMap.draw(row, 4, sf::Quads, sf::RenderStates(polarMap));
+    }
+
+    m_polarMap.display();
+
+    // Second pass, the discs compared with their rows
+
+    for( size_t k(0); k < count; k++ )
+    {
+        Light& light = *lights[k];
+
+        Point center = light.getGlobalCenter(),
+              axis = light.convertToGlobal(Point(1, 0));
+
+        float radius = light.getGlobalRadius();
+        double direction = std::atan2(axis.y - center.y, axis.x - center.x);
+
+        polarShading->setParameter("row", 1.f - (k + .5f) / height);
+        polarShading->setParameter("direction", direction < 0 ? direction + 6.28318531 : direction);
+        polarShading->setParameter("aperture", light.getAperture());
+        polarShading->setParameter("curve", static_cast<float>(light.getFalloff()));
+
+        float left = center.x - radius, top = center.y - radius, right = center.x + radius, bottom = center.y + radius;
+        const Color& color = light.getColor();
+
+        sf::Vertex disc[] = {sf::Vertex(sf::Vector2f(left,  top),    color, sf::Vector2f(-1, -1)),
+                             sf::Vertex(sf::Vector2f(right, top),    color, sf::Vector2f( 1, -1)),
+                             sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f( 1,  1)),
+                             sf::Vertex(sf::Vector2f(left,  bottom), color, sf::Vector2f(-1,  1))};
+
+        target.draw(disc, 4, sf::Quads, sf::RenderStates(polarShading));
+    }
+}
+
+////////////////////////////////////////////////////////////
+// Simplify the chain of points from begin to the end, a
+// closed chain goes back to its first point
+////////////////////////////////////////////////////////////
+static void simplify(std::vector<Point>& points, size_t begin, bool closed, double tolerance)
+{
+    // Merge the collinear segments and drop the points too close
+    // to the previous one, the ends of an open chain are kept
+
+    size_t last = begin;
+
+    for( size_t k(begin + 1); k < points.size(); k++ )
+    {
+        const Point& a = points[last];
+        const Point& p = points[k];
+        const Point& b = k + 1 < points.size() ? points[k + 1] : points[begin];
+
+        if( k + 1 == points.size() && !closed )
+        {
+            if( last > begin && Point(p.x - a.x, p.y - a.y).length() < tolerance )
+                last--;
+
+            points[++last] = p;
+            break;
+        }
+
+        double ux = p.x - a.x, uy = p.y - a.y,
+               vx = b.x - p.x, vy = b.y - p.y;
+
+        bool collinear = std::abs(ux * vy - uy * vx) <= 1e-9 * Point(ux, uy).length() * Point(vx, vy).length() && ux * vx + uy * vy >= 0;
+
+        if( !collinear && Point(ux, uy).length() >= tolerance )
+            points[++last] = p;
+    }
+
+    points.resize(last + 1);
+
+    // Without a tolerance, only the lossless merge is done
+
+    if( tolerance <= 0 )
+        return;
+
+    // Douglas-Peucker, the first point is repeated at the end of
+    // a closed chain so that the farthest point splits it
+
+    if( closed )
+        points.push_back(points[begin]);
+
+    size_t count = points.size() - begin;
+    std::vector<bool> kept(count, false);
+    std::vector<std::pair<size_t, size_t>> ranges;
+
+    kept.front() = kept.back() = true;
+
+    if( count > 2 )
+        ranges.push_back(std::make_pair(0, count - 1));
+
+    while( !ranges.empty() )
+    {
+        size_t first = ranges.back().first, second = ranges.back().second, farthest = first;
+        double distance = 0;
+
+        ranges.pop_back();
+
+        for( size_t k(first + 1); k < second; k++ )
+        {
+            double d = getDistance(points[begin + k], points[begin + first], points[begin + second]);
+
+            if( d > distance )
+                distance = d, farthest = k;
+        }
+
+        if( distance > tolerance )
+        {
+            kept[farthest] = true;
+
+            if( farthest - first > 1 )
+                ranges.push_back(std::make_pair(first, farthest));
+
+            if( second - farthest > 1 )
+                ranges.push_back(std::make_pair(farthest, second));
+        }
+    }
+
+    last = begin;
+
+    for( size_t k(1); k < count; k++ )
+        if( kept[k] )
+            points[++last] = points[begin + k];
+
+    points.resize(closed ? last : last + 1);
+}
+
+////////////////////////////////////////////////////////////
+LightManager::Occluder::Occluder(const Geom& geom, bool isStatic) :
+geom(geom),
+isStatic(isStatic),
+changed(true),
+moved(false),
+closedCount(0) {}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::load(double tolerance)
+{
+    if( changed )
+        trace(tolerance);
+
+    // The outline is kept in local coordinates, a move only
+    // transforms it again
+
+    std::vector<Point> chain;
+
+    segments.clear();
+    loops.clear();
+
+    for( size_t k(0); k + 1 < chains.size(); k++ )
+    {
+        chain.clear();
+
+        for( size_t i(chains[k]); i < chains[k + 1]; i++ )
+            chain.push_back(geom.convertToGlobal(outline[i]));
+
+        if( k < closedCount )
+        {
+            // The closed loops come first, oriented with their inside on the left
+
+            double area = 0;
+
+            for( size_t i(0); i < chain.size(); i++ )
+                area+=chain[i].x * chain[(i + 1) % chain.size()].y - chain[(i + 1) % chain.size()].x * chain[i].y;
+
+            if( area < 0 )
+                std::reverse(chain.begin(), chain.end());
+
+            loops.push_back(segments.size());
+
+            for( size_t i(0); i < chain.size(); i++ )
+                segments.push_back(Segment(chain[i], chain[(i + 1) % chain.size()]));
+        }
+
+        else
+            for( size_t i(0); i + 1 < chain.size(); i++ )
+                segments.push_back(Segment(chain[i], chain[i + 1]));
+    }
+
+    if( !loops.empty() )
+        loops.push_back(segments.size());
+
+    for( size_t k(0); k < segments.size(); k++ )
+    {
+        const Segment& s = segments[k];
+
+        if( k == 0 )
+            min = max = s.p1;
+
+        min = Point(std::min(min.x, std::min(s.p1.x, s.p2.x)), std::min(min.y, std::min(s.p1.y, s.p2.y)));
+        max = Point(std::max(max.x, std::max(s.p1.x, s.p2.x)), std::max(max.y, std::max(s.p1.y, s.p2.y)));
+    }
+
+    changed = false;
+    moved = false;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::trace(double tolerance)
+{
+    size_t verticesCount = geom.getVerticesCount(), liaisonsCount = geom.getLiaisonsCount();
+
+    // Link every vertex to its first two liaisons, only the
+    // vertices with exactly two of them continue a chain
+
+    std::vector<Uint32> degrees(verticesCount, 0);
+    std::vector<size_t> links(verticesCount * 2);
+    std::vector<bool> visited(liaisonsCount, false);
+
+    for( size_t k(0); k < liaisonsCount; k++ )
+    {
+        const Liaison& liaison = geom.getLiaison(k);
+
+        for( size_t indice : {liaison.v1.getIndice(), liaison.v2.getIndice()} )
+        {
+            if( degrees[indice] < 2 )
+                links[indice * 2 + degrees[indice]] = k;
+
+            degrees[indice]++;
+        }
+    }
+
+    // Walk the chains from their ends first, what remains are
+    // the closed loops, stored before the open chains
+
+    std::vector<Point> open;
+    std::vector<Uint32> openChains;
+
+    outline.clear();
+    chains.clear();
+
+    for( size_t pass(0); pass < 2; pass++ )
+        for( size_t k(0); k < liaisonsCount; k++ )
+        {
+            if( visited[k] )
+                continue;
+
+            const Liaison& first = geom.getLiaison(k);
+            size_t liaison = k, vertex = first.v1.getIndice();
+
+            if( pass == 0 && degrees[vertex] == 2 )
+            {
+                vertex = first.v2.getIndice();
+
+                if( degrees[vertex] == 2 )
+                    continue;
+            }
+
+            size_t begin = outline.size();
+            bool closed = true;
+
+            outline.push_back(geom.getVertex(vertex).getCoords());
+
+            while( !visited[liaison] )
+            {
+                const Liaison& current = geom.getLiaison(liaison);
+                size_t next = current.v1.getIndice() == vertex ? current.v2.getIndice() : current.v1.getIndice();
+
+                visited[liaison] = true;
+                outline.push_back(geom.getVertex(next).getCoords());
+
+                if( degrees[next] != 2 )
+                {
+                    closed = false;
+                    break;
+                }
+
+                liaison = links[next * 2] == liaison ? links[next * 2 + 1] : links[next * 2];
+                vertex = next;
+            }
+
+            // A loop ends on its first point
+
+            if( closed && liaison == k )
+                outline.pop_back();
+
+            else
+                closed = false;
+
+            simplify(outline, begin, closed, tolerance);
+
+            if( closed && outline.size() - begin >= 3 )
+                chains.push_back(begin);
+
+            else
+            {
+                const Point& a = outline[begin];
+                const Point& b = outline.back();
+
+                // An isolated edge under the tolerance is dropped too
+
+                if( outline.size() - begin > 2 || (outline.size() - begin == 2 && Point(b.x - a.x, b.y - a.y).length() >= tolerance) )
+                {
+                    openChains.push_back(open.size());
+                    open.insert(open.end(), outline.begin() + begin, outline.end());
+                }
+
+                outline.resize(begin);
+            }
+        }
+
+    closedCount = chains.size();
+
+    for( auto chain : openChains )
+        chains.push_back(outline.size() + chain);
+
+    outline.insert(outline.end(), open.begin(), open.end());
+    chains.push_back(outline.size());
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onTransformUpdated()
+{
+    moved = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onVertexAdded()
+{
+    changed = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onLiaisonAdded()
+{
+    changed = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onFaceAdded() {}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onVertexRemoved(size_t)
+{
+    changed = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onLiaisonRemoved(size_t)
+{
+    changed = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onFaceRemoved(size_t) {}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onVertexMoved()
+{
+    changed = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occluder::onErasing()
+{
+    changed = true;
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occlusion::insert(const Occluder& occluder)
+{
+    Uint32 first = grid.getSegments().size();
+    blocks[&occluder] = std::make_pair(first, static_cast<Uint32>(occluder.segments.size()));
+
+    for( auto& segment : occluder.segments )
+    {
+        grid.insert(segment);
+        loops.push_back(-1);
+    }
+
+    for( size_t k(0); k + 1 < occluder.loops.size(); k++ )
+    {
+        Int32 loop = ranges.size() / 2;
+
+        ranges.push_back(first + occluder.loops[k]);
+        ranges.push_back(first + occluder.loops[k + 1]);
+
+        for( size_t i(first + occluder.loops[k]); i < first + occluder.loops[k + 1]; i++ )
+            loops[i] = loop;
+    }
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occlusion::remove(const Occluder& occluder)
+{
+    auto it = blocks.find(&occluder);
+
+    if( it == blocks.end() )
+        return;
+
+    for( Uint32 k(it->second.first); k < it->second.first + it->second.second; k++ )
+        grid.remove(k);
+
+    blocks.erase(it);
+}
+
+////////////////////////////////////////////////////////////
+void LightManager::Occlusion::clear()
+{
+    grid.clear();
+    loops.clear();
+    ranges.clear();
+    blocks.clear();
+}
+
+////////////////////////////////////////////////////////////
+bool LightManager::Occlusion::contains(Int32 loop, const Point& point) const
+{
+    bool inside = false;
+
+    for( size_t k(ranges[loop * 2]); k < ranges[loop * 2 + 1]; k++ )
+    {
+        const Segment& s = grid.getSegment(k);
+
+        if( (s.p1.y > point.y) != (s.p2.y > point.y) &&
+            point.x < s.p1.x + (point.y - s.p1.y) * (s.p2.x - s.p1.x) / (s.p2.y - s.p1.y) )
+            inside = !inside;
+    }
+
+    return inside;
+}
+
+}
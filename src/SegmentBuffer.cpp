@@ -0,0 +1,305 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#include <Zoom/SegmentBuffer.hpp>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+// Tolerance on the position of the hit along a segment, so
+// that a ray passing through an endpoint is not missed
+////////////////////////////////////////////////////////////
+static const float tolerance = 1e-4f;
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::clear()
+{
+    m_x1.clear();
+    m_y1.clear();
+    m_x2.clear();
+    m_y2.clear();
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::push(const Segment& segment)
+{
+    push(segment.p1.x, segment.p1.y, segment.p2.x, segment.p2.y);
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::push(float x1, float y1, float x2, float y2)
+{
+    m_x1.push_back(x1);
+    m_y1.push_back(y1);
+    m_x2.push_back(x2);
+    m_y2.push_back(y2);
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::remove(size_t indice)
+{
+    m_x1[indice] = m_x1.back();
+    m_y1[indice] = m_y1.back();
+    m_x2[indice] = m_x2.back();
+    m_y2[indice] = m_y2.back();
+
+    m_x1.pop_back();
+    m_y1.pop_back();
+    m_x2.pop_back();
+    m_y2.pop_back();
+}
+
+////////////////////////////////////////////////////////////
+size_t SegmentBuffer::getSize() const
+{
+    return m_x1.size();
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::intersect(float dx, float dy, float* distances) const
+{
+    size_t k = 0;
+
+#if defined(ZOOM_AVX)
+
+    const __m256 rayX = _mm256_set1_ps(dx), rayY = _mm256_set1_ps(dy),
+                 zero = _mm256_setzero_ps(), low = _mm256_set1_ps(-tolerance), high = _mm256_set1_ps(1 + tolerance),
+                 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+
+    for( ; k + 8 <= m_x1.size(); k+=8 )
+    {
+        __m256 x1 = _mm256_loadu_ps(&m_x1[k]), y1 = _mm256_loadu_ps(&m_y1[k]),
+               ex = _mm256_sub_ps(_mm256_loadu_ps(&m_x2[k]), x1), ey = _mm256_sub_ps(_mm256_loadu_ps(&m_y2[k]), y1);
+
+        __m256 denom = _mm256_sub_ps(_mm256_mul_ps(rayX, ey), _mm256_mul_ps(rayY, ex)),
+               t = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(x1, ey), _mm256_mul_ps(y1, ex)), denom),
+               u = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(x1, rayY), _mm256_mul_ps(y1, rayX)), denom);
+
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(denom, zero, _CMP_NEQ_OQ),
+                     _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GE_OQ),
+                     _mm256_and_ps(_mm256_cmp_ps(u, low, _CMP_GE_OQ), _mm256_cmp_ps(u, high, _CMP_LE_OQ))));
+
+        _mm256_storeu_ps(distances + k, _mm256_blendv_ps(infinity, t, hit));
+    }
+
+#elif defined(ZOOM_SSE)
+
+    const __m128 rayX = _mm_set1_ps(dx), rayY = _mm_set1_ps(dy),
+                 zero = _mm_setzero_ps(), low = _mm_set1_ps(-tolerance), high = _mm_set1_ps(1 + tolerance),
+                 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+
+    for( ; k + 4 <= m_x1.size(); k+=4 )
+    {
+        __m128 x1 = _mm_loadu_ps(&m_x1[k]), y1 = _mm_loadu_ps(&m_y1[k]),
+               ex = _mm_sub_ps(_mm_loadu_ps(&m_x2[k]), x1), ey = _mm_sub_ps(_mm_loadu_ps(&m_y2[k]), y1);
+
+        __m128 denom = _mm_sub_ps(_mm_mul_ps(rayX, ey), _mm_mul_ps(rayY, ex)),
+               t = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(x1, ey), _mm_mul_ps(y1, ex)), denom),
+               u = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(x1, rayY), _mm_mul_ps(y1, rayX)), denom);
+
+        __m128 hit = _mm_and_ps(_mm_cmpneq_ps(denom, zero),
+                     _mm_and_ps(_mm_cmpge_ps(t, zero),
+                     _mm_and_ps(_mm_cmpge_ps(u, low), _mm_cmple_ps(u, high))));
+
+        _mm_storeu_ps(distances + k, _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, infinity)));
+    }
+
+#endif
+
+    intersectScalar(dx, dy, distances, k);
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::intersectScalar(float dx, float dy, float* distances) const
+{
+    intersectScalar(dx, dy, distances, 0);
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::cull(const Point& a, const Point& b, const Point& c, size_t begin, Uint8* culled) const
+{
+    Sides sides;
+
+    if( begin >= m_x1.size() )
+        return;
+
+    if( !getSides(a, b, c, sides) )
+    {
+        std::fill(culled, culled + m_x1.size() - begin, 0);
+        return;
+    }
+
+    size_t k = begin;
+
+#if defined(ZOOM_AVX)
+
+    for( ; k + 8 <= m_x1.size(); k+=8 )
+    {
+        __m256 x1 = _mm256_loadu_ps(&m_x1[k]), y1 = _mm256_loadu_ps(&m_y1[k]),
+               x2 = _mm256_loadu_ps(&m_x2[k]), y2 = _mm256_loadu_ps(&m_y2[k]),
+               outside = _mm256_setzero_ps();
+
+        for( size_t i(0); i < 3; i++ )
+        {
+            __m256 x = _mm256_set1_ps(sides.x[i]), y = _mm256_set1_ps(sides.y[i]),
+                   dx = _mm256_set1_ps(sides.dx[i]), dy = _mm256_set1_ps(sides.dy[i]),
+                   limit = _mm256_set1_ps(sides.limit[i]);
+
+            __m256 c1 = _mm256_sub_ps(_mm256_mul_ps(dx, _mm256_sub_ps(y1, y)), _mm256_mul_ps(dy, _mm256_sub_ps(x1, x))),
+                   c2 = _mm256_sub_ps(_mm256_mul_ps(dx, _mm256_sub_ps(y2, y)), _mm256_mul_ps(dy, _mm256_sub_ps(x2, x)));
+
+            outside = _mm256_or_ps(outside, _mm256_and_ps(_mm256_cmp_ps(c1, limit, _CMP_LT_OQ), _mm256_cmp_ps(c2, limit, _CMP_LT_OQ)));
+        }
+
+        int mask = _mm256_movemask_ps(outside);
+
+        for( size_t i(0); i < 8; i++ )
+            culled[k - begin + i] = (mask >> i) & 1;
+    }
+
+#elif defined(ZOOM_SSE)
+
+    for( ; k + 4 <= m_x1.size(); k+=4 )
+    {
+        __m128 x1 = _mm_loadu_ps(&m_x1[k]), y1 = _mm_loadu_ps(&m_y1[k]),
+               x2 = _mm_loadu_ps(&m_x2[k]), y2 = _mm_loadu_ps(&m_y2[k]),
+               outside = _mm_setzero_ps();
+
+        for( size_t i(0); i < 3; i++ )
+        {
+            __m128 x = _mm_set1_ps(sides.x[i]), y = _mm_set1_ps(sides.y[i]),
+                   dx = _mm_set1_ps(sides.dx[i]), dy = _mm_set1_ps(sides.dy[i]),
+                   limit = _mm_set1_ps(sides.limit[i]);
+
+            __m128 c1 = _mm_sub_ps(_mm_mul_ps(dx, _mm_sub_ps(y1, y)), _mm_mul_ps(dy, _mm_sub_ps(x1, x))),
+                   c2 = _mm_sub_ps(_mm_mul_ps(dx, _mm_sub_ps(y2, y)), _mm_mul_ps(dy, _mm_sub_ps(x2, x)));
+
+            outside = _mm_or_ps(outside, _mm_and_ps(_mm_cmplt_ps(c1, limit), _mm_cmplt_ps(c2, limit)));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+
+        for( size_t i(0); i < 4; i++ )
+            culled[k - begin + i] = (mask >> i) & 1;
+    }
+
+#endif
+
+    cullScalar(sides, begin, k, culled);
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::cullScalar(const Point& a, const Point& b, const Point& c, size_t begin, Uint8* culled) const
+{
+    Sides sides;
+
+    if( begin >= m_x1.size() )
+        return;
+
+    if( !getSides(a, b, c, sides) )
+        std::fill(culled, culled + m_x1.size() - begin, 0);
+
+    else
+        cullScalar(sides, begin, begin, culled);
+}
+
+////////////////////////////////////////////////////////////
+bool SegmentBuffer::getSides(const Point& a, const Point& b, const Point& c, Sides& sides)
+{
+    double area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+
+    if( area == 0 )
+        return false;
+
+    const Point* corners[] = {&a, area > 0 ? &b : &c, area > 0 ? &c : &b};
+    double extent = 1;
+
+    for( auto corner : corners )
+        extent = std::max(extent, std::max(std::abs(corner->x), std::abs(corner->y)));
+
+    for( size_t i(0); i < 3; i++ )
+    {
+        const Point& p = *corners[i];
+        const Point& q = *corners[(i + 1) % 3];
+
+        sides.x[i] = p.x;
+        sides.y[i] = p.y;
+        sides.dx[i] = q.x - p.x;
+        sides.dy[i] = q.y - p.y;
+
+        // The cross products are rounded in single precision, only
+        // the segments clearly beyond the side are culled
+
+        sides.limit[i] = -tolerance * std::sqrt(sides.dx[i] * sides.dx[i] + sides.dy[i] * sides.dy[i]) * extent;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::intersectScalar(float dx, float dy, float* distances, size_t begin) const
+{
+    for( size_t k(begin); k < m_x1.size(); k++ )
+    {
+        float ex = m_x2[k] - m_x1[k], ey = m_y2[k] - m_y1[k],
+              denom = dx * ey - dy * ex;
+
+        distances[k] = std::numeric_limits<float>::infinity();
+
+        if( denom == 0 )
+            continue;
+
+        float t = (m_x1[k] * ey - m_y1[k] * ex) / denom,
+              u = (m_x1[k] * dy - m_y1[k] * dx) / denom;
+
+        if( t >= 0 && u >= -tolerance && u <= 1 + tolerance )
+            distances[k] = t;
+    }
+}
+
+////////////////////////////////////////////////////////////
+void SegmentBuffer::cullScalar(const Sides& sides, size_t begin, size_t first, Uint8* culled) const
+{
+    for( size_t k(first); k < m_x1.size(); k++ )
+    {
+        bool outside = false;
+
+        for( size_t i(0); i < 3; i++ )
+        {
+            float c1 = sides.dx[i] * (m_y1[k] - sides.y[i]) - sides.dy[i] * (m_x1[k] - sides.x[i]),
+                  c2 = sides.dx[i] * (m_y2[k] - sides.y[i]) - sides.dy[i] * (m_x2[k] - sides.x[i]);
+
+            if( c1 < sides.limit[i] && c2 < sides.limit[i] )
+                outside = true;
+        }
+
+        culled[k - begin] = outside;
+    }
+}
+
+}
@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#include <Zoom/SegmentGrid.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+SegmentGrid::SegmentGrid(double cellSize) :
+m_cellSize(cellSize > 0 ? cellSize : 128),
+m_removedCount(0) {}
+
+////////////////////////////////////////////////////////////
+void SegmentGrid::setCellSize(double cellSize)
+{
+    // The cells are indexed by dividing with their size
+
+    if( !(cellSize > 0) )
+        return;
+
+    m_cellSize = cellSize;
+    m_removedCount = 0;
+    m_segments.clear();
+    m_isRemoved.clear();
+    m_cells.clear();
+}
+
+////////////////////////////////////////////////////////////
+double SegmentGrid::getCellSize() const
+{
+    return m_cellSize;
+}
+
+////////////////////////////////////////////////////////////
+void SegmentGrid::clear()
+{
+    m_removedCount = 0;
+    m_segments.clear();
+    m_isRemoved.clear();
+
+    for( auto& cell : m_cells )
+        cell.second.clear();
+}
+
+////////////////////////////////////////////////////////////
+void SegmentGrid::insert(const Segment& segment)
+{
+    Uint32 indice = m_segments.size();
+
+    m_segments.push_back(segment);
+    m_isRemoved.push_back(false);
+
+    getKeys(segment, m_keys);
+
+    for( auto key : m_keys )
+        m_cells[key].push_back(indice);
+}
+
+////////////////////////////////////////////////////////////
+void SegmentGrid::remove(Uint32 indice)
+{
+    if( m_isRemoved[indice] )
+        return;
+
+    getKeys(m_segments[indice], m_keys);
+
+    // The order within a cell doesn't matter, the queries sort it
+
+    for( auto key : m_keys )
+    {
+        std::vector<Uint32>& cell = m_cells[key];
+        auto it = std::find(cell.begin(), cell.end(), indice);
+
+        if( it != cell.end() )
+        {
+            *it = cell.back();
+            cell.pop_back();
+        }
+    }
+
+    m_isRemoved[indice] = true;
+    m_removedCount++;
+}
+
+////////////////////////////////////////////////////////////
+bool SegmentGrid::isRemoved(size_t indice) const
+{
+    return m_isRemoved[indice];
+}
+
+////////////////////////////////////////////////////////////
+size_t SegmentGrid::getRemovedCount() const
+{
+    return m_removedCount;
+}
+
+////////////////////////////////////////////////////////////
+void SegmentGrid::query(const Point& center, double radius, std::vector<Uint32>& indices) const
+{
+    query(Point(center.x - radius, center.y - radius), Point(center.x + radius, center.y + radius), indices);
+}
+
+////////////////////////////////////////////////////////////
+void SegmentGrid::query(const Point& min, const Point& max, std::vector<Uint32>& indices) const
+{
+    indices.clear();
+
+    Int64 xMin = std::floor(min.x / m_cellSize), xMax = std::floor(max.x / m_cellSize),
+          yMin = std::floor(min.y / m_cellSize), yMax = std::floor(max.y / m_cellSize);
+
+    for( Int64 x(xMin); x <= xMax; x++ )
+        for( Int64 y(yMin); y <= yMax; y++ )
+        {
+            auto it = m_cells.find(getKey(x, y));
+
+            if( it != m_cells.end() )
+                indices.insert(indices.end(), it->second.begin(), it->second.end());
+        }
+
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+}
+
+////////////////////////////////////////////////////////////
+const Segment& SegmentGrid::getSegment(size_t indice) const
+{
+    return m_segments[indice];
+}
+
+////////////////////////////////////////////////////////////
+const std::vector<Segment>& SegmentGrid::getSegments() const
+{
+    return m_segments;
+}
+
+////////////////////////////////////////////////////////////
+Int64 SegmentGrid::getKey(Int64 x, Int64 y)
+{
+    return static_cast<Int64>((static_cast<Uint64>(x) << 32) ^ static_cast<Uint32>(y));
+}
+
+////////////////////////////////////////////////////////////
+void SegmentGrid::getKeys(const Segment& segment, std::vector<Int64>& keys) const
+{
+    keys.clear();
+
+    const Point& p1 = segment.p1;
+    const Point& p2 = segment.p2;
+
+    Int64 xMin = std::floor(std::min(p1.x, p2.x) / m_cellSize), xMax = std::floor(std::max(p1.x, p2.x) / m_cellSize),
+          yMin = std::floor(std::min(p1.y, p2.y) / m_cellSize), yMax = std::floor(std::max(p1.y, p2.y) / m_cellSize);
+
+    double dx = p2.x - p1.x, dy = p2.y - p1.y;
+
+    for( Int64 x(xMin); x <= xMax; x++ )
+        for( Int64 y(yMin); y <= yMax; y++ )
+        {
+            // Skip the cells of the bounding box the segment doesn't cross
+
+            if( xMin != xMax && yMin != yMax )
+            {
+                double left = x * m_cellSize, top = y * m_cellSize, right = left + m_cellSize, bottom = top + m_cellSize;
+
+                double c1 = dx * (top    - p1.y) - dy * (left  - p1.x),
+                       c2 = dx * (top    - p1.y) - dy * (right - p1.x),
+                       c3 = dx * (bottom - p1.y) - dy * (left  - p1.x),
+                       c4 = dx * (bottom - p1.y) - dy * (right - p1.x);
+
+                if( (c1 > 0 && c2 > 0 && c3 > 0 && c4 > 0) || (c1 < 0 && c2 < 0 && c3 < 0 && c4 < 0) )
+                    continue;
+            }
+
+            keys.push_back(getKey(x, y));
+        }
+}
+
+}
@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#include <Zoom/ShaderLibrary.hpp>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+// Vertices flagged by their first texture coordinate are
+// projected to infinity, away from the light
+////////////////////////////////////////////////////////////
+static const char* shadowVolumeVertex =
+    "uniform vec2 light;"
+    "void main()"
+    "{"
+    "    vec4 vertex = gl_Vertex;"
+    "    if( gl_MultiTexCoord0.x > 0.5 )"
+    "        vertex = vec4(vertex.xy - light, 0.0, 0.0);"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vertex;"
+    "    gl_FrontColor = gl_Color;"
+    "}";
+
+////////////////////////////////////////////////////////////
+// Forward the raw texture coordinates, SFML only normalizes
+// them when a texture is bound
+////////////////////////////////////////////////////////////
+static const char* coordsVertex =
+    "varying vec2 coords;"
+    "void main()"
+    "{"
+    "    coords = gl_MultiTexCoord0.xy;"
+    "    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;"
+    "    gl_FrontColor = gl_Color;"
+    "}";
+
+////////////////////////////////////////////////////////////
+// March from the center of the light in the occluders texture
+// along the angle given by the first coordinate, the radius is
+// in texture coordinates and the texture is upside down since
+// it comes from a render texture
+////////////////////////////////////////////////////////////
+static const char* polarMapFragment =
+    "uniform sampler2D occluders;"
+    "uniform vec2 center;"
+    "uniform vec2 radius;"
+    "varying vec2 coords;"
+    "void main()"
+    "{"
+    "    float angle = coords.x * 6.28318531;"
+    "    vec2 direction = vec2(cos(angle), -sin(angle)) * radius;"
+    "    float distance = 1.0;"
+    "    for( int k = 0; k < 256; k++ )"
+    "    {"
+    "        float along = float(k) / 256.0;"
+    "        if( texture2D(occluders, center + direction * along).a > 0.0 )"
+    "        {"
+    "            distance = along;"
+    "            break;"
+    "        }"
+    "    }"
+    "    gl_FragColor = vec4(distance, distance, distance, 1.0);"
+    "}";
+
+////////////////////////////////////////////////////////////
+// Attenuation at a distance from the center of a light, the
+// curve is 0 for linear, 1 for quadratic and 2 for smoothstep
+////////////////////////////////////////////////////////////
+#define ZOOM_ATTENUATE \
+    "uniform float curve;" \
+    "float attenuate(float distance)" \
+    "{" \
+    "    if( curve > 1.5 )" \
+    "        return 1.0 - smoothstep(0.0, 1.0, distance);" \
+    "    if( curve > 0.5 )" \
+    "        return (1.0 - distance) * (1.0 - distance);" \
+    "    return 1.0 - distance;" \
+    "}"
+
+////////////////////////////////////////////////////////////
+// The coordinates are the local position divided by the
+// radius, the disc of the light is cut out per pixel
+////////////////////////////////////////////////////////////
+static const char* falloffFragment =
+    ZOOM_ATTENUATE
+    "varying vec2 coords;"
+    "void main()"
+    "{"
+    "    float distance = length(coords);"
+    "    if( distance > 1.0 )"
+    "        discard;"
+    "    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * attenuate(distance));"
+    "}";
+
+////////////////////////////////////////////////////////////
+// The coordinates go from -1 to 1 across the disc of the light
+////////////////////////////////////////////////////////////
+static const char* polarShadingFragment =
+    ZOOM_ATTENUATE
+    "uniform sampler2D polarMap;"
+    "uniform float row;"
+    "uniform float direction;"
+    "uniform float aperture;"
+    "varying vec2 coords;"
+    "void main()"
+    "{"
+    "    float distance = length(coords);"
+    "    float angle = atan(coords.y, coords.x);"
+    "    if( angle < 0.0 )"
+    "        angle += 6.28318531;"
+    "    if( distance > 1.0 || mod(angle - direction, 6.28318531) > aperture )"
+    "        discard;"
+    "    if( distance > texture2D(polarMap, vec2(angle / 6.28318531, row)).r )"
+    "        discard;"
+    "    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * attenuate(distance));"
+    "}";
+
+////////////////////////////////////////////////////////////
+// The coordinates go from -1 to 1 across the quad of a marker
+////////////////////////////////////////////////////////////
+static const char* roundPointFragment =
+    "varying vec2 coords;"
+    "void main()"
+    "{"
+    "    if( dot(coords, coords) > 1.0 )"
+    "        discard;"
+    "    gl_FragColor = gl_Color;"
+    "}";
+
+////////////////////////////////////////////////////////////
+static const char* colorFragment =
+    "void main()"
+    "{"
+    "    gl_FragColor = gl_Color;"
+    "}";
+
+////////////////////////////////////////////////////////////
+sf::Shader* ShaderLibrary::getShadowVolume()
+{
+    static sf::Shader shader;
+    static sf::Shader* loaded = load(shader, shadowVolumeVertex, colorFragment);
+
+    return loaded;
+}
+
+////////////////////////////////////////////////////////////
+sf::Shader* ShaderLibrary::getPolarMap()
+{
+    static sf::Shader shader;
+    static sf::Shader* loaded = load(shader, coordsVertex, polarMapFragment);
+
+    return loaded;
+}
+
+////////////////////////////////////////////////////////////
+sf::Shader* ShaderLibrary::getPolarShading()
+{
+    static sf::Shader shader;
+    static sf::Shader* loaded = load(shader, coordsVertex, polarShadingFragment);
+
+    return loaded;
+}
+
+////////////////////////////////////////////////////////////
+sf::Shader* ShaderLibrary::getFalloff()
+{
+    static sf::Shader shader;
+    static sf::Shader* loaded = load(shader, coordsVertex, falloffFragment);
+
+    return loaded;
+}
+
+////////////////////////////////////////////////////////////
+sf::Shader* ShaderLibrary::getRoundPoint()
+{
+    static sf::Shader shader;
+    static sf::Shader* loaded = load(shader, coordsVertex, roundPointFragment);
+
+    return loaded;
+}
+
+////////////////////////////////////////////////////////////
+sf::Shader* ShaderLibrary::load(sf::Shader& shader, const char* vertex, const char* fragment)
+{
+    if( !sf::Shader::isAvailable() )
+        return nullptr;
+
+    return shader.loadFromMemory(vertex, fragment) ? &shader : nullptr;
+}
+
+}
@@ -22,26 +22,68 @@
 ////////////////////////////////////////////////////////////
 
 #include <Zoom/Shape.hpp>
+#include <Zoom/ShaderLibrary.hpp>
 #include <Zoost/Converter.hpp>
+#include <cmath>
 
 namespace zin
 {
 
+////////////////////////////////////////////////////////////
+// Offset of an element without vertices in the arrays
+////////////////////////////////////////////////////////////
+static const Uint32 none = static_cast<Uint32>(-1);
+
+////////////////////////////////////////////////////////////
+// Get the circle of 40 sides shared by the markers, its first
+// point repeated at the end
+////////////////////////////////////////////////////////////
+static const sf::Vector2f* getUnitCircle()
+{
+    static const std::vector<sf::Vector2f> circle = []()
+    {
+        std::vector<sf::Vector2f> points(41);
+
+        for( size_t i(0); i <= 40; i++ )
+            points[i] = sf::Vector2f(std::cos(i * .157079633), std::sin(i * .157079633));
+
+        return points;
+    }();
+
+    return circle.data();
+}
+
 ////////////////////////////////////////////////////////////
 Shape::Shape(Geom& geom) :
+m_debugMode(false),
 m_geom(geom),
+m_faces(sf::Triangles),
+m_liaisons(sf::Quads),
+m_joins(sf::Triangles),
+m_markers(sf::Triangles),
+m_wireframe(sf::Lines),
+m_vertexArrayDebug(sf::Lines),
+m_needUpdate(true),
+m_needRecolor(false),
+m_needDebugUpdate(true),
+m_needMove(false),
 m_isVertexShowed(false),
 m_isLiaisonShowed(true),
 m_isFaceShowed(true),
 m_isFaceColorEnabled(true),
+m_isMarkerShaded(ShaderLibrary::getRoundPoint() != nullptr),
 m_defaultVertexColor(Color::White),
 m_defaultLiaisonColor(Color::White),
 m_defaultFaceColor(Color::White),
 m_defaultLiaisonWidth(1),
 m_defaultVertexSize(1),
-m_needUpdate(true),
-m_debugMode(false)
+m_join(Stroker::None)
 {
+    // The markers are quads when the shader can round them
+
+    if( m_isMarkerShaded )
+        m_markers.setPrimitiveType(sf::Quads);
+
     for( size_t k(0); k < m_geom.getVerticesCount(); k++ )
         onVertexAdded();
 
@@ -122,14 +164,14 @@ void Shape::setVerticesColor(const Color& color)
         info.color = color;
 
     m_defaultVertexColor = color;
-    m_needUpdate = true;
+    m_needRecolor = true;
 }
     
 ////////////////////////////////////////////////////////////
 void Shape::setVertexColor(size_t indice, const Color& color)
 {
     m_vertexInfos[indice].color = color;
-    m_needUpdate = true;
+    m_dirtyVertices.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -139,14 +181,14 @@ void Shape::setLiaisonsColor(const Color& color)
         info.color = color;
 
     m_defaultLiaisonColor = color;
-    m_needUpdate = true;
+    m_needRecolor = true;
 }
 
 ////////////////////////////////////////////////////////////
 void Shape::setLiaisonColor(size_t indice, const Color& color)
 {
     m_liaisonInfos[indice].color = color;
-    m_needUpdate = true;
+    m_dirtyLiaisons.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -156,14 +198,14 @@ void Shape::setFacesColor(const Color& color)
         info.color = color;
 
     m_defaultFaceColor = color;
-    m_needUpdate = true;
+    m_needRecolor = true;
 }
 
 ////////////////////////////////////////////////////////////
 void Shape::setFaceColor(size_t indice, const Color& color)
 {
     m_faceInfos[indice].color = color;
-    m_needUpdate = true;
+    m_dirtyFaces.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -180,7 +222,7 @@ void Shape::setVerticesSize(Uint16 size)
 void Shape::setVertexSize(size_t indice, Uint16 size)
 {
     m_vertexInfos[indice].size = size;
-    m_needUpdate = true;
+    m_dirtyVertices.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -197,9 +239,22 @@ void Shape::setLiaisonsWidth(Uint16 width)
 void Shape::setLiaisonWidth(size_t indice, Uint16 width)
 {
     m_liaisonInfos[indice].width = width;
+    m_dirtyLiaisons.push_back(indice);
+}
+
+////////////////////////////////////////////////////////////
+void Shape::setLiaisonsJoin(Stroker::Join join)
+{
+    m_join = join;
     m_needUpdate = true;
 }
 
+////////////////////////////////////////////////////////////
+Stroker::Join Shape::getLiaisonsJoin() const
+{
+    return m_join;
+}
+
 ////////////////////////////////////////////////////////////
 void Shape::showVertices(bool showed)
 {
@@ -214,7 +269,7 @@ void Shape::showVertices(bool showed)
 void Shape::showVertex(size_t indice, bool showed)
 {
     m_vertexInfos[indice].showed = showed;
-    m_needUpdate = true;
+    m_dirtyVertices.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -231,7 +286,7 @@ void Shape::showLiaisons(bool showed)
 void Shape::showLiaison(size_t indice, bool showed)
 {
     m_liaisonInfos[indice].showed = showed;
-    m_needUpdate = true;
+    m_dirtyLiaisons.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -248,7 +303,7 @@ void Shape::showFaces(bool showed)
 void Shape::showFace(size_t indice, bool showed)
 {
     m_faceInfos[indice].showed = showed;
-    m_needUpdate = true;
+    m_dirtyFaces.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -258,14 +313,14 @@ void Shape::enableFacesColor(bool enabled)
         info.enableColor = enabled;
 
     m_isFaceColorEnabled = enabled;
-    m_needUpdate = true;
+    m_needRecolor = true;
 }
 
 ////////////////////////////////////////////////////////////
 void Shape::enableFaceColor(size_t indice, bool enabled)
 {
     m_faceInfos[indice].enableColor = enabled;
-    m_needUpdate = true;
+    m_dirtyFaces.push_back(indice);
 }
 
 ////////////////////////////////////////////////////////////
@@ -281,185 +336,485 @@ bool Shape::getDebugMode()
     return m_debugMode;
 }
 
+////////////////////////////////////////////////////////////
+// Append a line to an array of lines
+////////////////////////////////////////////////////////////
+static void appendLine(sf::VertexArray& array, const Point& p1, const Point& p2, const sf::Color& color)
+{
+    array.append(sf::Vertex(sf::Vector2f(p1.x, p1.y), color));
+    array.append(sf::Vertex(sf::Vector2f(p2.x, p2.y), color));
+}
+
 ////////////////////////////////////////////////////////////
 void Shape::update() const
 {
     if( m_needUpdate )
     {
-        m_vertexArray.clear();
-        m_vertexArrayDebug.clear();
+        // The arrays keep their memory from an update to the next
 
-        if( m_debugMode )
-        {
-            for( size_t k(0); k < m_geom.getFacesCount(); k++ )
-            {
-                Face& face = m_geom.getFace(k);
+        m_faces.clear();
+        m_liaisons.clear();
+        m_joins.clear();
+        m_markers.clear();
+        m_faceOffsets.assign(m_faceInfos.size(), none);
+        m_liaisonOffsets.assign(m_liaisonInfos.size(), none);
+        m_markerOffsets.assign(m_vertexInfos.size(), none);
+        m_joinOffsets.assign(m_vertexInfos.size(), none);
 
-                Vector2d p1 = face.v1.getCoords();
-                Vector2d p2 = face.v2.getCoords();
-                Vector2d p3 = face.v3.getCoords();
-                    
-                sf::VertexArray lines(sf::LinesStrip, 4);
+        link();
 
-                lines[0].position = sf::Vector2f(p1.x, p1.y);
-                lines[1].position = sf::Vector2f(p2.x, p2.y);
-                lines[2].position = sf::Vector2f(p3.x, p3.y);
-                lines[3].position = sf::Vector2f(p1.x, p1.y);
+        if( m_debugMode )
+            updateWireframe();
 
-                lines[0].color = sf::Color::White;
-                lines[1].color = sf::Color::White;
-                lines[2].color = sf::Color::White;
-                lines[3].color = sf::Color::White;
+        else
+        {
+            for( size_t k(0); k < m_faceInfos.size(); k++ )
+                writeFace(k);
 
-                m_vertexArray.push_back(lines);
-            }
+            // The normals of all the liaisons are computed at once
+
+            m_stroker.clear();
 
-            for( size_t k(0); k < m_geom.getLiaisonsCount(); k++ )
+            for( size_t k(0); k < m_liaisonInfos.size(); k++ )
             {
                 Liaison& liaison = m_geom.getLiaison(k);
 
-                Vector2d p1 = liaison.v1.getCoords();
-                Vector2d p2 = liaison.v2.getCoords();
+                m_stroker.push(liaison.v1.getCoords(), liaison.v2.getCoords(), m_liaisonInfos[k].width);
+            }
 
-                sf::VertexArray line(sf::Lines, 2);
+            m_stroker.computeNormals();
 
-                line[0].position = sf::Vector2f(p1.x, p1.y);
-                line[1].position = sf::Vector2f(p2.x, p2.y);
+            for( size_t k(0); k < m_liaisonInfos.size(); k++ )
+                writeLiaison(k, m_stroker.getNormal(k));
 
-                line[0].color = sf::Color::White;
-                line[1].color = sf::Color::White;
+            if( m_join != Stroker::None )
+                for( size_t k(0); k < m_vertexInfos.size(); k++ )
+                    if( m_liaisonStarts[k + 1] - m_liaisonStarts[k] == 2 )
+                        writeJoin(k, m_stroker.getNormal(m_liaisonLinks[m_liaisonStarts[k]]), m_stroker.getNormal(m_liaisonLinks[m_liaisonStarts[k] + 1]));
 
-                m_vertexArray.push_back(line);
-            }
+            for( size_t k(0); k < m_vertexInfos.size(); k++ )
+                writeMarker(k);
+        }
 
-            const Rect& rect = m_geom.getGlobalBounds();
-            Point origin = m_geom.convertToGlobal(m_geom.getOrigin());
+        m_dirtyFaces.clear();
+        m_dirtyLiaisons.clear();
+        m_dirtyVertices.clear();
 
-            sf::VertexArray circle(sf::LinesStrip, 10);
+        m_needUpdate = false;
+        m_needRecolor = false;
+        m_needMove = false;
+        m_needDebugUpdate = true;
+    }
 
-            double angus = 0;
-                
-            for( size_t k(0); k < 10; k++ )
-            {
-                circle[k].position = sf::Vector2f(origin.x + std::cos(angus) * 11, origin.y + std::sin(angus) * 11);
-                circle[k].color = sf::Color::Red;
-                angus+=.698131701f;
-            }
+    else
+    {
+        // A moved vertex only affects its marker and the liaisons
+        // and faces it belongs to
 
-            m_vertexArrayDebug.push_back(circle);
+        if( m_needMove )
+        {
+            for( size_t k(0); k < m_coords.size(); k++ )
+            {
+                Point point = m_geom.getVertex(k).getCoords();
 
-            sf::VertexArray lines(sf::LinesStrip, 5);
+                if( point.x == m_coords[k].x && point.y == m_coords[k].y )
+                    continue;
 
-            lines[0].position = sf::Vector2f(rect.pos.x - 1, rect.pos.y - 1);
-            lines[1].position = sf::Vector2f(rect.pos.x + rect.size.x + 1, rect.pos.y - 1);
-            lines[2].position = sf::Vector2f(rect.pos.x + rect.size.x + 1, rect.pos.y + rect.size.y + 1);
-            lines[3].position = sf::Vector2f(rect.pos.x - 1, rect.pos.y + rect.size.y + 1);
-            lines[4].position = sf::Vector2f(rect.pos.x - 1, rect.pos.y - 1);
+                m_coords[k] = point;
+                m_dirtyVertices.push_back(k);
+                m_dirtyLiaisons.insert(m_dirtyLiaisons.end(), m_liaisonLinks.begin() + m_liaisonStarts[k], m_liaisonLinks.begin() + m_liaisonStarts[k + 1]);
+                m_dirtyFaces.insert(m_dirtyFaces.end(), m_faceLinks.begin() + m_faceStarts[k], m_faceLinks.begin() + m_faceStarts[k + 1]);
+            }
 
-            lines[0].color = sf::Color::Red;
-            lines[1].color = sf::Color::Red;
-            lines[2].color = sf::Color::Red;
-            lines[3].color = sf::Color::Red;
-            lines[4].color = sf::Color::Red;
+            m_needMove = false;
+            m_needDebugUpdate = true;
+        }
 
-            m_vertexArrayDebug.push_back(lines);
+        if( m_needRecolor )
+        {
+            updateColors();
+            m_needRecolor = false;
         }
 
-        else
+        bool isDirty = !m_dirtyFaces.empty() || !m_dirtyLiaisons.empty() || !m_dirtyVertices.empty();
+
+        if( m_debugMode && isDirty )
+            updateWireframe();
+
+        else if( isDirty )
         {
-            for( size_t k(0); k < m_geom.getFacesCount(); k++ )
-            {
-                if( m_faceInfos[k].showed )
+            for( auto indice : m_dirtyFaces )
+                writeFace(indice);
+
+            for( auto indice : m_dirtyLiaisons )
+                writeLiaison(indice, getNormal(indice));
+
+            if( m_join != Stroker::None )
+                for( auto indice : m_dirtyLiaisons )
                 {
-                    Face& face = m_geom.getFace(k);
-
-                    Vector2d p1 = face.v1.getCoords();
-                    Vector2d p2 = face.v2.getCoords();
-                    Vector2d p3 = face.v3.getCoords();
-                    
-                    sf::VertexArray array(sf::Triangles, 3);
-
-                    array[0].position = sf::Vector2f(p1.x, p1.y);
-                    array[1].position = sf::Vector2f(p2.x, p2.y);
-                    array[2].position = sf::Vector2f(p3.x, p3.y);
-
-                    array[0].color = m_faceInfos[k].color;
-                    array[1].color = m_faceInfos[k].color;
-                    array[2].color = m_faceInfos[k].color;
-                    
-                    m_vertexArray.push_back(array);
+                    Liaison& liaison = m_geom.getLiaison(indice);
+
+                    updateJoin(liaison.v1.getIndice());
+                    updateJoin(liaison.v2.getIndice());
                 }
-            }
 
-            for( size_t k(0); k < m_geom.getLiaisonsCount(); k++ )
-            {
-                if( m_liaisonInfos[k].showed )
-                {
-                    Liaison& liaison = m_geom.getLiaison(k);
+            for( auto indice : m_dirtyVertices )
+                writeMarker(indice);
+        }
 
-                    Vector2d a = liaison.v1.getCoords();
-                    Vector2d b = liaison.v2.getCoords();
+        m_dirtyFaces.clear();
+        m_dirtyLiaisons.clear();
+        m_dirtyVertices.clear();
+    }
 
-                    double angle = std::atan((b.y - a.y) / (b.x - a.x));
-                    double width = m_liaisonInfos[k].width;
+    if( m_needDebugUpdate && m_debugMode )
+    {
+        updateDebug();
+        m_needDebugUpdate = false;
+    }
+}
 
-                    sf::VertexArray line(sf::Quads, 4);
+////////////////////////////////////////////////////////////
+void Shape::link() const
+{
+    size_t count = m_geom.getVerticesCount();
 
-                    line[0].position = sf::Vector2f(a.x + width * std::cos(angle + toRads( 90)), a.y + width * std::sin(angle + toRads( 90)));
-                    line[1].position = sf::Vector2f(a.x + width * std::cos(angle + toRads(270)), a.y + width * std::sin(angle + toRads(270)));
-                    line[2].position = sf::Vector2f(b.x + width * std::cos(angle + toRads(270)), b.y + width * std::sin(angle + toRads(270)));
-                    line[3].position = sf::Vector2f(b.x + width * std::cos(angle + toRads( 90)), b.y + width * std::sin(angle + toRads( 90)));
+    m_coords.resize(count);
 
-                    line[0].color = m_vertexInfos[k].color;
-                    line[1].color = m_vertexInfos[k].color;
-                    line[2].color = m_vertexInfos[k].color;
-                    line[3].color = m_vertexInfos[k].color;
+    for( size_t k(0); k < count; k++ )
+        m_coords[k] = m_geom.getVertex(k).getCoords();
 
-                    m_vertexArray.push_back(line);
-                }
-            }
+    // The liaisons and faces of every vertex, counted then filled
 
-            for( size_t k(0); k < m_geom.getVerticesCount(); k++ )
+    m_liaisonStarts.assign(count + 1, 0);
+    m_faceStarts.assign(count + 1, 0);
 
-                if( m_vertexInfos[k].showed )
+    for( size_t k(0); k < m_geom.getLiaisonsCount(); k++ )
+    {
+        Liaison& liaison = m_geom.getLiaison(k);
 
-                    if( m_vertexInfos[k].size > 0 )
-                    {
-                        Point point = m_geom.getVertex(k).getCoords();
+        m_liaisonStarts[liaison.v1.getIndice() + 1]++;
+        m_liaisonStarts[liaison.v2.getIndice() + 1]++;
+    }
 
-                        sf::VertexArray circle(sf::TrianglesFan, 40);
+    for( size_t k(0); k < m_geom.getFacesCount(); k++ )
+    {
+        Face& face = m_geom.getFace(k);
 
-                        circle[0].position = sf::Vector2f(point.x, point.y);
-                        circle[0].color = m_vertexInfos[k].color;
+        m_faceStarts[face.v1.getIndice() + 1]++;
+        m_faceStarts[face.v2.getIndice() + 1]++;
+        m_faceStarts[face.v3.getIndice() + 1]++;
+    }
 
-                        double angus;
-                            
-                        for( size_t k(1); k < 40; k++ )
-                        {
-                            circle[k].position = sf::Vector2f(point.x + std::cos(angus) * m_vertexInfos[k].size, point.y + std::sin(angus) * m_vertexInfos[k].size);
-                            circle[k].color = m_vertexInfos[k].color;
+    for( size_t k(0); k < count; k++ )
+    {
+        m_liaisonStarts[k + 1] += m_liaisonStarts[k];
+        m_faceStarts[k + 1] += m_faceStarts[k];
+    }
 
-                            angus+=.157079633f;
-                        }
+    m_liaisonLinks.resize(m_liaisonStarts[count]);
+    m_faceLinks.resize(m_faceStarts[count]);
 
-                        m_vertexArray.push_back(circle);
-                    }
-                }
+    std::vector<Uint32> liaisonEnds(m_liaisonStarts.begin(), m_liaisonStarts.end() - 1),
+                        faceEnds(m_faceStarts.begin(), m_faceStarts.end() - 1);
 
-        m_needUpdate = false;
+    for( size_t k(0); k < m_geom.getLiaisonsCount(); k++ )
+    {
+        Liaison& liaison = m_geom.getLiaison(k);
+
+        m_liaisonLinks[liaisonEnds[liaison.v1.getIndice()]++] = k;
+        m_liaisonLinks[liaisonEnds[liaison.v2.getIndice()]++] = k;
+    }
+
+    for( size_t k(0); k < m_geom.getFacesCount(); k++ )
+    {
+        Face& face = m_geom.getFace(k);
+
+        m_faceLinks[faceEnds[face.v1.getIndice()]++] = k;
+        m_faceLinks[faceEnds[face.v2.getIndice()]++] = k;
+        m_faceLinks[faceEnds[face.v3.getIndice()]++] = k;
     }
 }
 
+////////////////////////////////////////////////////////////
+void Shape::writeFace(size_t indice) const
+{
+    const FaceInfo& info = m_faceInfos[indice];
+    Uint32& offset = m_faceOffsets[indice];
+
+    // A hidden element gets a place once shown, and keeps it
+    // flattened when hidden again until the next rebuild
+
+    if( offset == none )
+    {
+        if( !info.showed )
+            return;
+
+        offset = m_faces.getVertexCount();
+        m_faces.resize(offset + 3);
+    }
+
+    sf::Vertex* vertices = &m_faces[offset];
+
+    if( !info.showed )
+    {
+        vertices[1].position = vertices[2].position = vertices[0].position;
+        return;
+    }
+
+    Face& face = m_geom.getFace(indice);
+
+    Point p1 = face.v1.getCoords();
+    Point p2 = face.v2.getCoords();
+    Point p3 = face.v3.getCoords();
+
+    vertices[0] = sf::Vertex(sf::Vector2f(p1.x, p1.y), info.color);
+    vertices[1] = sf::Vertex(sf::Vector2f(p2.x, p2.y), info.color);
+    vertices[2] = sf::Vertex(sf::Vector2f(p3.x, p3.y), info.color);
+}
+
+////////////////////////////////////////////////////////////
+sf::Vector2f Shape::getNormal(size_t indice) const
+{
+    Liaison& liaison = m_geom.getLiaison(indice);
+
+    return Stroker::getNormal(liaison.v1.getCoords(), liaison.v2.getCoords(), m_liaisonInfos[indice].width);
+}
+
+////////////////////////////////////////////////////////////
+void Shape::writeLiaison(size_t indice, const sf::Vector2f& normal) const
+{
+    const LiaisonInfo& info = m_liaisonInfos[indice];
+    Uint32& offset = m_liaisonOffsets[indice];
+
+    if( offset == none )
+    {
+        if( !info.showed )
+            return;
+
+        offset = m_liaisons.getVertexCount();
+        m_liaisons.resize(offset + 4);
+    }
+
+    sf::Vertex* vertices = &m_liaisons[offset];
+
+    if( !info.showed )
+    {
+        vertices[1].position = vertices[2].position = vertices[3].position = vertices[0].position;
+        return;
+    }
+
+    Liaison& liaison = m_geom.getLiaison(indice);
+
+    Point a = liaison.v1.getCoords();
+    Point b = liaison.v2.getCoords();
+
+    // The quad is offset on both sides along the normal
+
+    sf::Vector2f p1(a.x, a.y), p2(b.x, b.y);
+
+    vertices[0] = sf::Vertex(p1 + normal, info.color);
+    vertices[1] = sf::Vertex(p1 - normal, info.color);
+    vertices[2] = sf::Vertex(p2 - normal, info.color);
+    vertices[3] = sf::Vertex(p2 + normal, info.color);
+}
+
+////////////////////////////////////////////////////////////
+void Shape::writeJoin(size_t indice, const sf::Vector2f& first, const sf::Vector2f& second) const
+{
+    Uint32& offset = m_joinOffsets[indice];
+
+    if( offset == none )
+    {
+        offset = m_joins.getVertexCount();
+        m_joins.resize(offset + Stroker::getJoinSize(m_join));
+    }
+
+    size_t a = m_liaisonLinks[m_liaisonStarts[indice]],
+           b = m_liaisonLinks[m_liaisonStarts[indice] + 1];
+
+    sf::Vector2f point(m_coords[indice].x, m_coords[indice].y);
+
+    // A hidden liaison leaves a null normal, flattening the join
+
+    if( !m_liaisonInfos[a].showed || !m_liaisonInfos[b].showed )
+    {
+        Stroker::writeJoin(&m_joins[offset], m_join, point, sf::Vector2f(), sf::Vector2f(), m_liaisonInfos[a].color);
+        return;
+    }
+
+    // Along the path, the first liaison comes in and the second
+    // goes out
+
+    sf::Vector2f in = m_geom.getLiaison(a).v2.getIndice() == indice ? first : -first,
+                 out = m_geom.getLiaison(b).v1.getIndice() == indice ? second : -second;
+
+    Stroker::writeJoin(&m_joins[offset], m_join, point, in, out, m_liaisonInfos[a].color);
+}
+
+////////////////////////////////////////////////////////////
+void Shape::updateJoin(size_t indice) const
+{
+    if( m_liaisonStarts[indice + 1] - m_liaisonStarts[indice] == 2 )
+        writeJoin(indice, getNormal(m_liaisonLinks[m_liaisonStarts[indice]]), getNormal(m_liaisonLinks[m_liaisonStarts[indice] + 1]));
+}
+
+////////////////////////////////////////////////////////////
+Uint32 Shape::getMarkerSize() const
+{
+    return m_isMarkerShaded ? 4 : 120;
+}
+
+////////////////////////////////////////////////////////////
+void Shape::writeMarker(size_t indice) const
+{
+    const VertexInfo& info = m_vertexInfos[indice];
+    Uint32& offset = m_markerOffsets[indice];
+    Uint32 size = getMarkerSize();
+    bool isShowed = info.showed && info.size > 0;
+
+    if( offset == none )
+    {
+        if( !isShowed )
+            return;
+
+        offset = m_markers.getVertexCount();
+        m_markers.resize(offset + size);
+    }
+
+    sf::Vertex* vertices = &m_markers[offset];
+
+    if( !isShowed )
+    {
+        for( size_t i(1); i < size; i++ )
+            vertices[i].position = vertices[0].position;
+
+        return;
+    }
+
+    Point point = m_geom.getVertex(indice).getCoords();
+    sf::Vector2f center(point.x, point.y);
+    float radius = info.size;
+
+    // The shader discards the corners of the quad, using the
+    // coordinates going from -1 to 1 across it
+
+    if( m_isMarkerShaded )
+    {
+        vertices[0] = sf::Vertex(center + sf::Vector2f(-radius, -radius), info.color, sf::Vector2f(-1, -1));
+        vertices[1] = sf::Vertex(center + sf::Vector2f( radius, -radius), info.color, sf::Vector2f( 1, -1));
+        vertices[2] = sf::Vertex(center + sf::Vector2f( radius,  radius), info.color, sf::Vector2f( 1,  1));
+        vertices[3] = sf::Vertex(center + sf::Vector2f(-radius,  radius), info.color, sf::Vector2f(-1,  1));
+
+        return;
+    }
+
+    const sf::Vector2f* circle = getUnitCircle();
+
+    for( size_t i(0); i < 40; i++ )
+    {
+        vertices[i * 3]     = sf::Vertex(center, info.color);
+        vertices[i * 3 + 1] = sf::Vertex(center + circle[i] * radius, info.color);
+        vertices[i * 3 + 2] = sf::Vertex(center + circle[i + 1] * radius, info.color);
+    }
+}
+
+////////////////////////////////////////////////////////////
+void Shape::updateWireframe() const
+{
+    m_wireframe.clear();
+
+    for( size_t k(0); k < m_geom.getFacesCount(); k++ )
+    {
+        Face& face = m_geom.getFace(k);
+
+        Point p1 = face.v1.getCoords();
+        Point p2 = face.v2.getCoords();
+        Point p3 = face.v3.getCoords();
+
+        appendLine(m_wireframe, p1, p2, sf::Color::White);
+        appendLine(m_wireframe, p2, p3, sf::Color::White);
+        appendLine(m_wireframe, p3, p1, sf::Color::White);
+    }
+
+    for( size_t k(0); k < m_geom.getLiaisonsCount(); k++ )
+    {
+        Liaison& liaison = m_geom.getLiaison(k);
+
+        appendLine(m_wireframe, liaison.v1.getCoords(), liaison.v2.getCoords(), sf::Color::White);
+    }
+}
+
+////////////////////////////////////////////////////////////
+void Shape::updateColors() const
+{
+    // The debug wireframe has no colors of its own
+
+    if( m_debugMode )
+        return;
+
+    for( size_t k(0); k < m_faceOffsets.size(); k++ )
+        if( m_faceOffsets[k] != none )
+            for( Uint32 i(0); i < 3; i++ )
+                m_faces[m_faceOffsets[k] + i].color = m_faceInfos[k].color;
+
+    for( size_t k(0); k < m_liaisonOffsets.size(); k++ )
+        if( m_liaisonOffsets[k] != none )
+            for( Uint32 i(0); i < 4; i++ )
+                m_liaisons[m_liaisonOffsets[k] + i].color = m_liaisonInfos[k].color;
+
+    for( size_t k(0); k < m_joinOffsets.size(); k++ )
+        if( m_joinOffsets[k] != none )
+            for( Uint32 i(0); i < Stroker::getJoinSize(m_join); i++ )
+                m_joins[m_joinOffsets[k] + i].color = m_liaisonInfos[m_liaisonLinks[m_liaisonStarts[k]]].color;
+
+    for( size_t k(0); k < m_markerOffsets.size(); k++ )
+        if( m_markerOffsets[k] != none )
+            for( Uint32 i(0); i < getMarkerSize(); i++ )
+                m_markers[m_markerOffsets[k] + i].color = m_vertexInfos[k].color;
+}
+
+////////////////////////////////////////////////////////////
+void Shape::updateDebug() const
+{
+    m_vertexArrayDebug.clear();
+
+    const Rect& rect = m_geom.getGlobalBounds();
+    Point origin = m_geom.convertToGlobal(m_geom.getOrigin());
+
+    double angus = 0;
+
+    for( size_t k(0); k < 9; k++ )
+    {
+        appendLine(m_vertexArrayDebug, Point(origin.x + std::cos(angus) * 11, origin.y + std::sin(angus) * 11),
+                                       Point(origin.x + std::cos(angus + .698131701) * 11, origin.y + std::sin(angus + .698131701) * 11), sf::Color::Red);
+        angus += .698131701;
+    }
+
+    Point corners[] = {Point(rect.pos.x - 1, rect.pos.y - 1),
+                       Point(rect.pos.x + rect.size.x + 1, rect.pos.y - 1),
+                       Point(rect.pos.x + rect.size.x + 1, rect.pos.y + rect.size.y + 1),
+                       Point(rect.pos.x - 1, rect.pos.y + rect.size.y + 1)};
+
+    for( size_t k(0); k < 4; k++ )
+        appendLine(m_vertexArrayDebug, corners[k], corners[(k + 1) % 4], sf::Color::Red);
+}
+
 ////////////////////////////////////////////////////////////
 void Shape::onTransformUpdated()
 {
-    m_needUpdate = true;
+    // The transform is applied when drawing, only the debug
+    // overlays are in global coordinates
+
+    m_needDebugUpdate = true;
 }
 
 ////////////////////////////////////////////////////////////
 void Shape::onVertexMoved()
 {
-    m_needUpdate = true;
+    // The moved vertices are found by their cached coordinates
+
+    m_needMove = true;
 }
 
 ////////////////////////////////////////////////////////////
@@ -475,16 +830,36 @@ void Shape::draw(sf::RenderTarget& target, sf::RenderStates states) const
 
     update();
 
-    for( auto& vertexArray : m_vertexArray )
-        target.draw(vertexArray, states);
+    // A single draw call per kind of element
 
     if( m_debugMode )
     {
+        target.draw(m_wireframe, states);
+
         states.transform = defaultTransform;
 
-        for( auto& vertexArray : m_vertexArrayDebug )
-            target.draw(vertexArray, states);
+        target.draw(m_vertexArrayDebug, states);
+    }
+
+    else
+    {
+        if( m_faces.getVertexCount() > 0 )
+            target.draw(m_faces, states);
+
+        if( m_liaisons.getVertexCount() > 0 )
+            target.draw(m_liaisons, states);
+
+        if( m_joins.getVertexCount() > 0 )
+            target.draw(m_joins, states);
+
+        if( m_markers.getVertexCount() > 0 )
+        {
+            if( m_isMarkerShaded )
+                states.shader = ShaderLibrary::getRoundPoint();
+
+            target.draw(m_markers, states);
+        }
     }
 }
 
-}
\ No newline at end of file
+}
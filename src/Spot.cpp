@@ -23,6 +23,7 @@
 ////////////////////////////////////////////////////////////
 
 #include <Zoom/Spot.hpp>
+#include <cmath>
 
 namespace zin
 {
@@ -33,20 +34,64 @@ Light(radius, color, complexity),
 m_aperture(aperture) {}
 
 ////////////////////////////////////////////////////////////
-void Spot::generate(const std::vector<Segment>& segments)
+double Spot::getAperture() const
 {
-    clear();
-    m_colors.clear();
+    return m_aperture;
+}
+
+////////////////////////////////////////////////////////////
+bool Spot::isInReach(const Segment& s) const
+{
+    if( !Light::isInReach(s) )
+        return false;
+
+    // One of the endpoints lies in the cone
+
+    for( auto& p : {s.p1, s.p2} )
+    {
+        double angle = std::atan2(p.y, p.x);
+
+        if( angle < 0 )
+            angle+=6.28318531;
+
+        if( p.length() <= m_radius && angle <= m_aperture )
+            return true;
+    }
+
+    // The segment crosses one of the sides of the cone
+
+    Point i;
+
+    if( s.intersects(Segment({0, 0}, {m_radius, 0}), i) ||
+        s.intersects(Segment({0, 0}, {std::cos(m_aperture) * m_radius, std::sin(m_aperture) * m_radius}), i) )
+        return true;
+
+    // The segment crosses the arc of the cone
+
+    double dx = s.p2.x - s.p1.x, dy = s.p2.y - s.p1.y,
+           a = dx * dx + dy * dy,
+           b = 2 * (s.p1.x * dx + s.p1.y * dy),
+           c = s.p1.x * s.p1.x + s.p1.y * s.p1.y - m_radius * m_radius,
+           delta = b * b - 4 * a * c;
+
+    if( a == 0 || delta < 0 )
+        return false;
+
+    for( double t : {(-b - std::sqrt(delta)) / (2 * a), (-b + std::sqrt(delta)) / (2 * a)} )
+    {
+        if( t < 0 || t > 1 )
+            continue;
+
+        double angle = std::atan2(s.p1.y + dy * t, s.p1.x + dx * t);
 
-    addVertex({0, 0});
-    m_colors.push_back(m_color);
+        if( angle < 0 )
+            angle+=6.28318531;
 
-    double angle = 0, delta = m_aperture / static_cast<double>(m_complexity);
-        
-    for( size_t k(0); k < m_complexity; k++ )
-        addTriangle({std::cos(angle) * m_radius, std::sin(angle) * m_radius}, {std::cos(angle + delta) * m_radius, std::sin(angle + delta) * m_radius}, 0, segments), angle+=delta;
+        if( angle <= m_aperture )
+            return true;
+    }
 
-    m_needUpdate = true;
+    return false;
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,233 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+
+#include <Zoom/Stroker.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+// Number of triangles of a round join, the corner is halved
+// that many times
+////////////////////////////////////////////////////////////
+static const Uint32 roundSteps = 8;
+
+////////////////////////////////////////////////////////////
+// Longest miter relative to the width, sharper corners are
+// beveled
+////////////////////////////////////////////////////////////
+static const float miterLimit = 4;
+
+////////////////////////////////////////////////////////////
+void Stroker::clear()
+{
+    m_dx.clear();
+    m_dy.clear();
+    m_widths.clear();
+    m_nx.clear();
+    m_ny.clear();
+}
+
+////////////////////////////////////////////////////////////
+void Stroker::push(const Point& p1, const Point& p2, float width)
+{
+    m_dx.push_back(p2.x - p1.x);
+    m_dy.push_back(p2.y - p1.y);
+    m_widths.push_back(width);
+}
+
+////////////////////////////////////////////////////////////
+size_t Stroker::getSize() const
+{
+    return m_dx.size();
+}
+
+////////////////////////////////////////////////////////////
+void Stroker::computeNormals()
+{
+    size_t k = 0;
+
+    m_nx.resize(m_dx.size());
+    m_ny.resize(m_dx.size());
+
+    // The empty edges get a null normal, their infinite scale
+    // being masked out
+
+#if defined(ZOOM_AVX)
+
+    const __m256 zero = _mm256_setzero_ps();
+
+    for( ; k + 8 <= m_dx.size(); k+=8 )
+    {
+        __m256 dx = _mm256_loadu_ps(&m_dx[k]), dy = _mm256_loadu_ps(&m_dy[k]),
+               length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))),
+               scale = _mm256_and_ps(_mm256_cmp_ps(length, zero, _CMP_GT_OQ), _mm256_div_ps(_mm256_loadu_ps(&m_widths[k]), length));
+
+        _mm256_storeu_ps(&m_nx[k], _mm256_mul_ps(_mm256_sub_ps(zero, dy), scale));
+        _mm256_storeu_ps(&m_ny[k], _mm256_mul_ps(dx, scale));
+    }
+
+#elif defined(ZOOM_SSE)
+
+    const __m128 zero = _mm_setzero_ps();
+
+    for( ; k + 4 <= m_dx.size(); k+=4 )
+    {
+        __m128 dx = _mm_loadu_ps(&m_dx[k]), dy = _mm_loadu_ps(&m_dy[k]),
+               length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))),
+               scale = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_div_ps(_mm_loadu_ps(&m_widths[k]), length));
+
+        _mm_storeu_ps(&m_nx[k], _mm_mul_ps(_mm_sub_ps(zero, dy), scale));
+        _mm_storeu_ps(&m_ny[k], _mm_mul_ps(dx, scale));
+    }
+
+#endif
+
+    computeNormalsScalar(k);
+}
+
+////////////////////////////////////////////////////////////
+void Stroker::computeNormalsScalar(size_t begin)
+{
+    for( size_t k(begin); k < m_dx.size(); k++ )
+    {
+        float length = std::sqrt(m_dx[k] * m_dx[k] + m_dy[k] * m_dy[k]),
+              scale = length > 0 ? m_widths[k] / length : 0;
+
+        m_nx[k] = -m_dy[k] * scale;
+        m_ny[k] = m_dx[k] * scale;
+    }
+}
+
+////////////////////////////////////////////////////////////
+sf::Vector2f Stroker::getNormal(size_t indice) const
+{
+    return sf::Vector2f(m_nx[indice], m_ny[indice]);
+}
+
+////////////////////////////////////////////////////////////
+sf::Vector2f Stroker::getNormal(const Point& p1, const Point& p2, float width)
+{
+    float dx = p2.x - p1.x, dy = p2.y - p1.y,
+          length = std::sqrt(dx * dx + dy * dy),
+          scale = length > 0 ? width / length : 0;
+
+    return sf::Vector2f(-dy * scale, dx * scale);
+}
+
+////////////////////////////////////////////////////////////
+Uint32 Stroker::getJoinSize(Join join)
+{
+    switch( join )
+    {
+        case Miter : return 6;
+        case Bevel : return 3;
+        case Round : return roundSteps * 3;
+        default    : return 0;
+    }
+}
+
+////////////////////////////////////////////////////////////
+void Stroker::writeJoin(sf::Vertex* vertices, Join join, const sf::Vector2f& point, const sf::Vector2f& in, const sf::Vector2f& out, const sf::Color& color)
+{
+    Uint32 size = getJoinSize(join);
+
+    for( Uint32 i(0); i < size; i++ )
+        vertices[i] = sf::Vertex(point, color);
+
+    float cross = in.x * out.y - in.y * out.x,
+          dot = in.x * out.x + in.y * out.y;
+
+    // Nothing to fill along a straight line or next to an empty edge
+
+    if( size == 0 || (cross == 0 && dot >= 0) )
+        return;
+
+    // The outer side is on the right of a left turn
+
+    sf::Vector2f a = cross > 0 ? -in : in,
+                 b = cross > 0 ? -out : out;
+
+    if( join == Round )
+    {
+        // The rotation of a step comes from halving the angle
+        // between the normals, instead of trigonometry
+
+        float width = std::sqrt(a.x * a.x + a.y * a.y),
+              c = std::max(-1.f, std::min(1.f, dot / (width * std::sqrt(b.x * b.x + b.y * b.y)))),
+              s = 0;
+
+        for( Uint32 steps(1); steps < roundSteps; steps*=2 )
+        {
+            s = std::sqrt((1 - c) / 2);
+            c = std::sqrt((1 + c) / 2);
+        }
+
+        // The arc turns around the end of the edge coming in, which
+        // also holds when the line goes back on itself
+
+        if( in.x * a.x + in.y * a.y > 0 )
+            s = -s;
+
+        sf::Vector2f p = a;
+
+        for( Uint32 i(0); i < roundSteps; i++ )
+        {
+            sf::Vector2f q = i + 1 == roundSteps ? b : sf::Vector2f(p.x * c - p.y * s, p.x * s + p.y * c);
+
+            vertices[i * 3 + 1].position = point + p;
+            vertices[i * 3 + 2].position = point + q;
+
+            p = q;
+        }
+
+        return;
+    }
+
+    vertices[1].position = point + a;
+    vertices[2].position = point + b;
+
+    // The miter tip is on the bisector, as far as the width over
+    // the cosine of half the angle
+
+    if( join == Miter )
+    {
+        sf::Vector2f m = a + b;
+        float width2 = a.x * a.x + a.y * a.y,
+              projection = m.x * a.x + m.y * a.y,
+              length2 = m.x * m.x + m.y * m.y;
+
+        if( projection > 0 && length2 * width2 <= miterLimit * miterLimit * projection * projection )
+        {
+            vertices[3].position = point + a;
+            vertices[4].position = point + m * (width2 / projection);
+            vertices[5].position = point + b;
+        }
+    }
+}
+
+}
@@ -0,0 +1,289 @@
+////////////////////////////////////////////////////////////
+//
+// Zoom C++ library
+// Copyright (C) 2011-2012 Pierre-Emmanuel BRIAN (zinlibs@gmail.com)
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#include <Zoom/Visibility.hpp>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace zin
+{
+
+////////////////////////////////////////////////////////////
+void Visibility::compute(const std::vector<Segment>& segments, double radius, double aperture, Uint32 complexity, std::vector<Point>& output)
+{
+    const double epsilon = 1e-10;
+    const size_t none = static_cast<size_t>(-1);
+
+    m_edges.clear();
+    m_active.clear();
+    m_activeBuffer.clear();
+    m_events.clear();
+
+    if( complexity == 0 )
+        return;
+
+    // The boundary is the polygon the wedges of the light used to describe
+
+    double delta = aperture / static_cast<double>(complexity);
+
+    for( size_t k(0); k < complexity; k++ )
+    {
+        double begin = delta * k, end = delta * (k + 1);
+
+        m_edges.push_back({Point(std::cos(begin) * radius, std::sin(begin) * radius),
+                           Point(std::cos(end) * radius, std::sin(end) * radius),
+                           begin, end});
+    }
+
+    for( auto& segment : segments )
+        addSegment(segment.p1, segment.p2, aperture);
+
+    // Sort the endpoints by angle
+
+    for( auto& edge : m_edges )
+    {
+        m_events.push_back(edge.begin);
+        m_events.push_back(edge.end);
+    }
+
+    std::sort(m_events.begin(), m_events.end());
+    m_events.erase(std::unique(m_events.begin(), m_events.end(), [epsilon](double a, double b) { return b - a < epsilon; }), m_events.end());
+
+    std::sort(m_edges.begin(), m_edges.end(), [](const Edge& a, const Edge& b) { return a.begin < b.begin; });
+
+    // Sweep the events, keeping the set of the edges crossed by the ray.
+    // It is a flat buffer rather than a tree ordered by distance since
+    // the walls may cross, so each event scans its k active edges
+
+    size_t next = 0;
+
+    for( size_t k(0); k + 1 < m_events.size(); k++ )
+    {
+        double angle = m_events[k], limit = m_events[k + 1];
+
+        for( size_t i(0); i < m_active.size(); )
+        {
+            if( m_edges[m_active[i]].end <= angle + epsilon )
+            {
+                m_active[i] = m_active.back();
+                m_active.pop_back();
+                m_activeBuffer.remove(i);
+            }
+
+            else
+                i++;
+        }
+
+        for( ; next < m_edges.size() && m_edges[next].begin <= angle + epsilon; next++ )
+            if( m_edges[next].end > angle + epsilon )
+            {
+                const Edge& edge = m_edges[next];
+
+                m_active.push_back(next);
+                m_activeBuffer.push(edge.p1.x, edge.p1.y, edge.p2.x, edge.p2.y);
+            }
+
+        if( m_active.empty() )
+            continue;
+
+        size_t front = getNearest(angle, limit);
+        Point hit = getHit(m_edges[front], angle);
+
+        // Walls may cross each other between two endpoints, so follow
+        // the nearest edge until no other active edge passes in front
+
+        while( true )
+        {
+            const Edge& a = m_edges[front];
+            size_t other = none;
+            double crossing = limit;
+            Point point;
+
+            for( auto i : m_active )
+            {
+                if( i == front )
+                    continue;
+
+                const Edge& b = m_edges[i];
+
+                double rx = a.p2.x - a.p1.x, ry = a.p2.y - a.p1.y,
+                       sx = b.p2.x - b.p1.x, sy = b.p2.y - b.p1.y,
+                       qx = b.p1.x - a.p1.x, qy = b.p1.y - a.p1.y,
+                       denom = rx * sy - ry * sx;
+
+                if( std::abs(denom) < epsilon )
+                    continue;
+
+                double t = (qx * sy - qy * sx) / denom,
+                       u = (qx * ry - qy * rx) / denom;
+
+                if( t <= 0 || t >= 1 || u <= 0 || u >= 1 )
+                    continue;
+
+                Point x(a.p1.x + rx * t, a.p1.y + ry * t);
+                double theta = getAngle(x);
+
+                if( theta > angle + epsilon && theta < crossing - epsilon )
+                {
+                    crossing = theta;
+                    other = i;
+                    point = x;
+                }
+            }
+
+            if( other == none )
+                break;
+
+            output.push_back(hit);
+            output.push_back(point);
+
+            front = getNearest(crossing, limit);
+            hit = point;
+            angle = crossing;
+        }
+
+        output.push_back(hit);
+        output.push_back(getHit(m_edges[front], limit));
+    }
+}
+
+////////////////////////////////////////////////////////////
+void Visibility::addSegment(Point p1, Point p2, double aperture)
+{
+    double cross = p1.x * p2.y - p1.y * p2.x;
+
+    // A segment aligned with the origin hides nothing
+
+    if( std::abs(cross) < 1e-9 )
+        return;
+
+    if( cross < 0 )
+        std::swap(p1, p2);
+
+    double begin = getAngle(p1), end = getAngle(p2);
+
+    if( end < begin )
+    {
+        Point i(p1.x + (p2.x - p1.x) * p1.y / (p1.y - p2.y), 0);
+
+        addEdge(p1, i, begin, 6.28318531, aperture);
+        addEdge(i, p2, 0, end, aperture);
+    }
+
+    else
+        addEdge(p1, p2, begin, end, aperture);
+}
+
+////////////////////////////////////////////////////////////
+void Visibility::addEdge(const Point& p1, Point p2, double begin, double end, double aperture)
+{
+    if( begin >= aperture )
+        return;
+
+    if( end > aperture )
+    {
+        p2 = getHit({p1, p2, begin, end}, aperture);
+        end = aperture;
+    }
+
+    if( end - begin > 1e-10 )
+        m_edges.push_back({p1, p2, begin, end});
+}
+
+////////////////////////////////////////////////////////////
+size_t Visibility::getNearest(double angle, double next)
+{
+    // Find the nearest distance in single precision for all the
+    // active edges at once, then only compare the edges close to
+    // it in double precision
+
+    m_distances.resize(m_active.size());
+    m_activeBuffer.intersect(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)), m_distances.data());
+
+    float threshold = *std::min_element(m_distances.begin(), m_distances.end());
+
+    if( threshold == std::numeric_limits<float>::infinity() )
+        threshold = std::numeric_limits<float>::max();
+
+    else
+        threshold += 1e-3f * std::max(1.f, threshold);
+
+    size_t nearest = static_cast<size_t>(-1);
+    double best = 0;
+
+    for( size_t k(0); k < m_active.size(); k++ )
+    {
+        if( m_distances[k] > threshold )
+            continue;
+
+        size_t i = m_active[k];
+        double distance = getDistance(m_edges[i], angle);
+
+        if( nearest == static_cast<size_t>(-1) )
+            nearest = i, best = distance;
+
+        else if( std::abs(distance - best) <= 1e-9 * std::max(1., best) )
+        {
+            if( getDistance(m_edges[i], next) < getDistance(m_edges[nearest], next) )
+                nearest = i, best = distance;
+        }
+
+        else if( distance < best )
+            nearest = i, best = distance;
+    }
+
+    return nearest;
+}
+
+////////////////////////////////////////////////////////////
+double Visibility::getDistance(const Edge& edge, double angle)
+{
+    double dx = std::cos(angle), dy = std::sin(angle),
+           ex = edge.p2.x - edge.p1.x, ey = edge.p2.y - edge.p1.y,
+           denom = dx * ey - dy * ex;
+
+    if( std::abs(denom) < 1e-12 )
+        return std::min(edge.p1.length(), edge.p2.length());
+
+    return (edge.p1.x * ey - edge.p1.y * ex) / denom;
+}
+
+////////////////////////////////////////////////////////////
+Point Visibility::getHit(const Edge& edge, double angle)
+{
+    double distance = getDistance(edge, angle);
+
+    return Point(std::cos(angle) * distance, std::sin(angle) * distance);
+}
+
+////////////////////////////////////////////////////////////
+double Visibility::getAngle(const Point& point)
+{
+    double angle = std::atan2(point.y, point.x);
+
+    return angle < 0 ? angle + 6.28318531 : angle;
+}
+
+}